@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace bintree {
+    // Binary tree whose nodes live in one contiguous arena and are linked by 32-bit indices.
+    // Nodes are addressed by TIndex handles that stay valid until clear().
+    // Detached subtrees are not reclaimed one by one, the whole arena is released by clear().
+    template <typename T>
+    class TArenaTree {
+    public:
+        using TIndex = std::uint32_t;
+        static constexpr TIndex npos = std::numeric_limits<TIndex>::max();
+
+        TArenaTree() = default;
+
+        explicit TArenaTree(size_t capacity) {
+            reserve(capacity);
+        }
+
+        void reserve(size_t capacity) {
+            nodes.reserve(capacity);
+        }
+
+        size_t size() const {
+            return nodes.size();
+        }
+
+        // drops every node at once, O(1) for trivially destructible T; capacity is kept
+        void clear() {
+            nodes.clear();
+        }
+
+        bool hasLeft(TIndex node) const {
+            return nodes[node].left != npos;
+        }
+
+        bool hasRight(TIndex node) const {
+            return nodes[node].right != npos;
+        }
+
+        bool hasParent(TIndex node) const {
+            return nodes[node].parent != npos;
+        }
+
+        T& getValue(TIndex node) {
+            return nodes[node].value;
+        }
+
+        const T& getValue(TIndex node) const {
+            return nodes[node].value;
+        }
+
+        TIndex getLeft(TIndex node) const {
+            return nodes[node].left;
+        }
+
+        TIndex getRight(TIndex node) const {
+            return nodes[node].right;
+        }
+
+        TIndex getParent(TIndex node) const {
+            return nodes[node].parent;
+        }
+
+        TIndex createLeaf(T v) {
+            nodes.push_back(TRecord{std::move(v), npos, npos, npos});
+            return TIndex(nodes.size() - 1);
+        }
+
+        TIndex fork(T v, TIndex left, TIndex right) {
+            auto node = createLeaf(std::move(v));
+            nodes[node].left = left;
+            nodes[node].right = right;
+            setParent(left, node);
+            setParent(right, node);
+            return node;
+        }
+
+        TIndex replaceLeft(TIndex node, TIndex l) {
+            setParent(l, node);
+            setParent(nodes[node].left, npos);
+            std::swap(l, nodes[node].left);
+            return l;
+        }
+
+        TIndex replaceRight(TIndex node, TIndex r) {
+            setParent(r, node);
+            setParent(nodes[node].right, npos);
+            std::swap(r, nodes[node].right);
+            return r;
+        }
+
+        TIndex replaceRightWithLeaf(TIndex node, T v) {
+            return replaceRight(node, createLeaf(std::move(v)));
+        }
+
+        TIndex replaceLeftWithLeaf(TIndex node, T v) {
+            return replaceLeft(node, createLeaf(std::move(v)));
+        }
+
+        TIndex removeLeft(TIndex node) {
+            return replaceLeft(node, npos);
+        }
+
+        TIndex removeRight(TIndex node) {
+            return replaceRight(node, npos);
+        }
+
+    private:
+        struct TRecord {
+            T value;
+            TIndex left;
+            TIndex right;
+            TIndex parent;
+        };
+
+        std::vector<TRecord> nodes;
+
+        void setParent(TIndex node, TIndex parent) {
+            if (node != npos)
+                nodes[node].parent = parent;
+        }
+    };
+}
@@ -0,0 +1,346 @@
+#include "tree.h"
+#include "arena_tree.h"
+#include "traversal.h"
+#include "reclaimer.h"
+#include "snapshot.h"
+#include "concurrent_tree.h"
+#include "persistent_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// ./bench [section]
+
+using bintree::TNode;
+using bintree::TArenaTree;
+
+namespace {
+    constexpr size_t num_nodes = 1 << 22;
+
+    using TClock = std::chrono::steady_clock;
+
+    double secondsSince(TClock::time_point start) {
+        return std::chrono::duration<double>(TClock::now() - start).count();
+    }
+
+    void report(const std::string& name, size_t ops, double seconds) {
+        std::cout << name << ": " << seconds * 1000 << " ms, "
+                  << ops / seconds / 1e6 << " Mops/s" << std::endl;
+    }
+
+    // complete tree of n nodes built bottom-up, level by level
+    TNode<int>::TNodePtr buildShared(size_t n) {
+        std::vector<TNode<int>::TNodePtr> level;
+        for (size_t i = 0; i < (n + 1) / 2; ++i)
+            level.push_back(TNode<int>::createLeaf(int(i)));
+        while (level.size() > 1) {
+            std::vector<TNode<int>::TNodePtr> next;
+            for (size_t i = 0; i + 1 < level.size(); i += 2)
+                next.push_back(TNode<int>::fork(int(i), level[i].get(), level[i + 1].get()));
+            if (level.size() % 2)
+                next.push_back(level.back());
+            level.swap(next);
+        }
+        return level.front();
+    }
+
+    TArenaTree<int>::TIndex buildArena(TArenaTree<int>& tree, size_t n) {
+        using TIndex = TArenaTree<int>::TIndex;
+        std::vector<TIndex> level;
+        for (size_t i = 0; i < (n + 1) / 2; ++i)
+            level.push_back(tree.createLeaf(int(i)));
+        while (level.size() > 1) {
+            std::vector<TIndex> next;
+            for (size_t i = 0; i + 1 < level.size(); i += 2)
+                next.push_back(tree.fork(int(i), level[i], level[i + 1]));
+            if (level.size() % 2)
+                next.push_back(level.back());
+            level.swap(next);
+        }
+        return level.front();
+    }
+
+    void benchArena() {
+        {
+            auto start = TClock::now();
+            auto root = buildShared(num_nodes);
+            report("shared_ptr build", num_nodes, secondsSince(start));
+            start = TClock::now();
+            root.reset();
+            report("shared_ptr teardown", num_nodes, secondsSince(start));
+        }
+        {
+            TArenaTree<int> tree;
+            auto start = TClock::now();
+            tree.reserve(num_nodes);
+            buildArena(tree, num_nodes);
+            report("arena build", num_nodes, secondsSince(start));
+            start = TClock::now();
+            tree.clear();
+            report("arena teardown", num_nodes, secondsSince(start));
+        }
+    }
+
+    long recursiveSum(TNode<int>::TNodePtr node) {
+        if (!node)
+            return 0;
+        return node->getValue() + recursiveSum(node->getLeft()) + recursiveSum(node->getRight());
+    }
+
+    template <typename TRangeT>
+    long iterativeSum(const TRangeT& range) {
+        long sum = 0;
+        for (const auto& node : range)
+            sum += node.getValue();
+        return sum;
+    }
+
+    void benchTraversal() {
+        auto root = buildShared(num_nodes);
+        const TNode<int>* raw = root.get();
+        long check = 0;
+
+        auto start = TClock::now();
+        check += recursiveSum(root);
+        report("recursive getLeft/getRight", num_nodes, secondsSince(start));
+
+        start = TClock::now();
+        check += iterativeSum(bintree::preOrder(raw));
+        report("preorder iterator", num_nodes, secondsSince(start));
+
+        start = TClock::now();
+        check += iterativeSum(bintree::inOrder(raw));
+        report("inorder iterator", num_nodes, secondsSince(start));
+
+        start = TClock::now();
+        check += iterativeSum(bintree::postOrder(raw));
+        report("postorder iterator", num_nodes, secondsSince(start));
+
+        start = TClock::now();
+        check += iterativeSum(bintree::levelOrder(raw));
+        report("levelorder iterator", num_nodes, secondsSince(start));
+
+        std::cout << "checksum " << check << std::endl;
+    }
+
+    void benchTeardown() {
+        auto root = buildShared(num_nodes);
+        auto start = TClock::now();
+        root.reset();
+        report("balanced, inline teardown", num_nodes, secondsSince(start));
+
+        auto spine = TNode<int>::createLeaf(0);
+        auto tail = spine.get();
+        for (size_t i = 1; i < num_nodes; ++i) {
+            tail->replaceRightWithLeaf(int(i));
+            tail = tail->getRawRight();
+        }
+        start = TClock::now();
+        spine.reset();
+        report("spine, inline teardown", num_nodes, secondsSince(start));
+
+        bintree::TReclaimer<int> reclaimer;
+        root = buildShared(num_nodes);
+        start = TClock::now();
+        reclaimer.retire(std::move(root));
+        report("balanced, caller side of background teardown", num_nodes, secondsSince(start));
+        reclaimer.flush();
+        report("balanced, background teardown until flushed", num_nodes, secondsSince(start));
+    }
+
+    void benchBulk() {
+        std::vector<int> sorted(num_nodes);
+        for (size_t i = 0; i < num_nodes; ++i)
+            sorted[i] = int(i);
+
+        auto start = TClock::now();
+        auto root = buildShared(num_nodes);
+        report("fork build", num_nodes, secondsSince(start));
+        root.reset();
+
+        start = TClock::now();
+        root = TNode<int>::buildBalanced(sorted.begin(), sorted.end());
+        report("buildBalanced", num_nodes, secondsSince(start));
+
+        start = TClock::now();
+        auto buffer = root->serialize();
+        report("serialize", num_nodes, secondsSince(start));
+        root.reset();
+
+        start = TClock::now();
+        root = TNode<int>::deserialize(buffer.data(), buffer.size());
+        report("deserialize", num_nodes, secondsSince(start));
+        std::cout << "snapshot size " << buffer.size() << " bytes" << std::endl;
+    }
+
+    void benchSnapshot() {
+        std::vector<int> sorted(num_nodes);
+        for (size_t i = 0; i < num_nodes; ++i)
+            sorted[i] = int(i);
+        auto root = TNode<int>::buildBalanced(sorted.begin(), sorted.end());
+        const std::string path = "bench_snapshot.bin";
+
+        auto start = TClock::now();
+        bintree::writeSnapshot(*root, path);
+        report("write snapshot", num_nodes, secondsSince(start));
+
+        auto buffer = root->serialize();
+        root.reset();
+        start = TClock::now();
+        root = TNode<int>::deserialize(buffer.data(), buffer.size());
+        report("load via deserialize", num_nodes, secondsSince(start));
+
+        start = TClock::now();
+        bintree::TSnapshot<int> snapshot(path);
+        report("load via mmap", num_nodes, secondsSince(start));
+
+        // random root-to-leaf lookups on both representations
+        constexpr size_t lookups = 1000000;
+        long check = 0;
+        start = TClock::now();
+        for (size_t i = 0; i < lookups; ++i) {
+            int key = int(i * 2654435761u % num_nodes);
+            auto node = root.get();
+            while (node && node->getValue() != key)
+                node = key < node->getValue() ? node->getRawLeft() : node->getRawRight();
+            check += node != nullptr;
+        }
+        report("lookup in TNode", lookups, secondsSince(start));
+
+        start = TClock::now();
+        for (size_t i = 0; i < lookups; ++i) {
+            int key = int(i * 2654435761u % num_nodes);
+            auto node = snapshot.root();
+            while (node && node->getValue() != key)
+                node = key < node->getValue() ? node->getLeft() : node->getRight();
+            check += node != nullptr;
+        }
+        report("lookup in snapshot", lookups, secondsSince(start));
+        std::cout << "found " << check << std::endl;
+        std::remove(path.c_str());
+    }
+
+    void benchConcurrent() {
+        using TTree = bintree::TConcurrentTree<int>;
+        constexpr size_t opsPerWriter = 1000000;
+        const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t writers = 1; writers <= maxThreads; writers *= 2) {
+            // writers own disjoint nodes hanging off a right spine, one reader keeps walking the tree
+            TTree tree(0);
+            std::vector<TTree::TNode*> owned;
+            auto tail = tree.getRoot();
+            for (size_t w = 0; w < writers; ++w) {
+                owned.push_back(TTree::createLeaf(int(w)));
+                tree.replaceLeft(tail, owned.back());
+                tree.replaceRightWithLeaf(tail, 0);
+                tail = tail->getRight();
+            }
+
+            std::atomic<bool> stop{false};
+            std::atomic<size_t> visited{0};
+            std::thread reader([&] {
+                while (!stop) {
+                    bintree::TEpochGuard guard;
+                    size_t count = 0;
+                    for (auto& node : bintree::preOrder(tree.getRoot()))
+                        count += node.getValue() >= 0;
+                    visited += count;
+                }
+            });
+
+            auto start = TClock::now();
+            std::vector<std::thread> threads;
+            for (size_t w = 0; w < writers; ++w) {
+                threads.emplace_back([&, w] {
+                    for (size_t i = 0; i < opsPerWriter; ++i)
+                        tree.replaceLeftWithLeaf(owned[w], int(i));
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+            auto seconds = secondsSince(start);
+            stop = true;
+            reader.join();
+            report(std::to_string(writers) + " writers", writers * opsPerWriter, seconds);
+            std::cout << "  reader visited " << visited / seconds / 1e6 << " Mnodes/s" << std::endl;
+        }
+    }
+
+    bintree::TPersistentNode<int>::TNodePtr deepCopy(const bintree::TPersistentNode<int>::TNodePtr& node) {
+        if (!node)
+            return nullptr;
+        return bintree::TPersistentNode<int>::fork(node->getValue(), deepCopy(node->getLeft()), deepCopy(node->getRight()));
+    }
+
+    void benchPersistent() {
+        using TPNode = bintree::TPersistentNode<int>;
+        constexpr size_t versions = 100000;
+        constexpr size_t deepVersions = 10;
+
+        std::vector<int> sorted(num_nodes);
+        for (size_t i = 0; i < num_nodes; ++i)
+            sorted[i] = int(i);
+        auto base = TPNode::buildBalanced(sorted.begin(), sorted.end());
+
+        // random root-to-leaf paths
+        std::vector<bintree::TPath> paths;
+        for (size_t i = 0; i < versions; ++i) {
+            bintree::TPath path;
+            auto node = base.get();
+            for (size_t bits = i * 2654435761u; node; bits >>= 1) {
+                auto direction = bits & 1 ? bintree::EDirection::Right : bintree::EDirection::Left;
+                node = (bits & 1 ? node->getRight() : node->getLeft()).get();
+                if (node)
+                    path.push_back(direction);
+            }
+            paths.push_back(std::move(path));
+        }
+
+        std::vector<TPNode::TNodePtr> history{base};
+        auto start = TClock::now();
+        for (size_t i = 0; i < versions; ++i)
+            history.push_back(TPNode::setValueAt(history.back(), paths[i], -int(i)));
+        report("path-copying versions", versions, secondsSince(start));
+        std::cout << "  " << paths[0].size() + 1 << " new nodes per version" << std::endl;
+        history.clear();
+
+        start = TClock::now();
+        for (size_t i = 0; i < deepVersions; ++i)
+            history.push_back(deepCopy(base));
+        report("deep-copy versions", deepVersions, secondsSince(start));
+        std::cout << "  " << num_nodes << " new nodes per version" << std::endl;
+    }
+
+    struct TSection {
+        const char* name;
+        void (*run)();
+    };
+
+    const TSection sections[] = {
+        {"arena", benchArena},
+        {"traversal", benchTraversal},
+        {"teardown", benchTeardown},
+        {"bulk", benchBulk},
+        {"snapshot", benchSnapshot},
+        {"concurrent", benchConcurrent},
+        {"persistent", benchPersistent},
+    };
+}
+
+int main(int argc, char** argv) {
+    for (const auto& section : sections) {
+        if (argc > 1 && std::strcmp(argv[1], section.name) != 0)
+            continue;
+        std::cout << "== " << section.name << std::endl;
+        section.run();
+    }
+}
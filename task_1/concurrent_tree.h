@@ -0,0 +1,374 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bintree {
+    // Epoch-based reclamation. Readers pin the current epoch while they hold raw pointers,
+    // retired objects are freed once every pinned thread has moved two epochs past their retirement.
+    // Every thread takes a slot on first use and gives it back when it exits. Slots come in chunks of
+    // slotsPerChunk; when all are taken another chunk is linked in, so any number of threads can run
+    // at once, and chunks are only freed with the domain.
+    class TEpochDomain {
+    public:
+        using TDeleter = void (*)(void*);
+
+        static TEpochDomain& instance() {
+            static TEpochDomain domain;
+            return domain;
+        }
+
+        TEpochDomain(const TEpochDomain&) = delete;
+        TEpochDomain& operator=(const TEpochDomain&) = delete;
+
+        ~TEpochDomain() {
+            // no readers are left at static destruction time
+            for (TChunk* chunk = &head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+                for (auto& slot : chunk->slots)
+                    freeAll(slot.retired);
+            }
+            freeAll(orphans);
+            for (TChunk* chunk = head.next.load(std::memory_order_acquire); chunk;) {
+                TChunk* next = chunk->next.load(std::memory_order_acquire);
+                delete chunk;
+                chunk = next;
+            }
+        }
+
+        void enter() {
+            auto& slot = local();
+            if (slot.nesting++ == 0) {
+                slot.epoch.store(globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void leave() {
+            auto& slot = local();
+            if (--slot.nesting == 0)
+                slot.epoch.store(idle, std::memory_order_release);
+        }
+
+        void retire(void* ptr, TDeleter deleter) {
+            auto& slot = local();
+            slot.retired.push_back({ptr, deleter, globalEpoch.load(std::memory_order_seq_cst)});
+            if (slot.retired.size() >= collectThreshold)
+                collect(slot);
+        }
+
+    private:
+        static constexpr size_t slotsPerChunk = 256;
+        static constexpr size_t collectThreshold = 64;
+        static constexpr std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+
+        struct TRetired {
+            void* ptr;
+            TDeleter deleter;
+            std::uint64_t epoch;
+        };
+
+        struct alignas(64) TSlot {
+            std::atomic<std::uint64_t> epoch{idle};
+            std::atomic<bool> used{false};
+            size_t nesting = 0;
+            std::vector<TRetired> retired;
+        };
+
+        struct TChunk {
+            TSlot slots[slotsPerChunk];
+            std::atomic<TChunk*> next{nullptr};
+        };
+
+        // releases the slot when its thread exits, leftovers go to the shared orphan list
+        struct TLocal {
+            TEpochDomain* domain = nullptr;
+            TSlot* slot = nullptr;
+
+            ~TLocal() {
+                if (!slot)
+                    return;
+                {
+                    std::lock_guard<std::mutex> l(domain->orphanGuard);
+                    domain->orphans.insert(domain->orphans.end(), slot->retired.begin(), slot->retired.end());
+                }
+                slot->retired.clear();
+                slot->used.store(false, std::memory_order_release);
+            }
+        };
+
+        std::atomic<std::uint64_t> globalEpoch{0};
+        TChunk head;
+        std::mutex orphanGuard;
+        std::vector<TRetired> orphans;
+
+        TEpochDomain() = default;
+
+        TSlot& local() {
+            thread_local TLocal local;
+            if (!local.slot) {
+                for (TChunk* chunk = &head; !local.slot;) {
+                    for (auto& slot : chunk->slots) {
+                        bool expected = false;
+                        if (slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                            local.slot = &slot;
+                            break;
+                        }
+                    }
+                    TChunk* next = chunk->next.load(std::memory_order_acquire);
+                    if (!local.slot && !next) {
+                        // every slot is taken, whoever links a chunk in first wins
+                        auto fresh = new TChunk();
+                        if (chunk->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel))
+                            next = fresh;
+                        else
+                            delete fresh;
+                    }
+                    chunk = next;
+                }
+                local.domain = this;
+            }
+            return *local.slot;
+        }
+
+        bool tryAdvance() {
+            auto epoch = globalEpoch.load(std::memory_order_seq_cst);
+            for (TChunk* chunk = &head; chunk; chunk = chunk->next.load(std::memory_order_seq_cst)) {
+                for (auto& slot : chunk->slots) {
+                    auto pinned = slot.epoch.load(std::memory_order_acquire);
+                    if (pinned != idle && pinned != epoch)
+                        return false;
+                }
+            }
+            return globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+        }
+
+        void collect(TSlot& slot) {
+            tryAdvance();
+            {
+                std::unique_lock<std::mutex> l(orphanGuard, std::try_to_lock);
+                if (l.owns_lock() && !orphans.empty()) {
+                    slot.retired.insert(slot.retired.end(), orphans.begin(), orphans.end());
+                    orphans.clear();
+                }
+            }
+            auto epoch = globalEpoch.load(std::memory_order_acquire);
+            auto kept = slot.retired.begin();
+            for (auto& item : slot.retired) {
+                if (item.epoch + 2 <= epoch)
+                    item.deleter(item.ptr);
+                else
+                    *kept++ = item;
+            }
+            slot.retired.erase(kept, slot.retired.end());
+        }
+
+        static void freeAll(std::vector<TRetired>& items) {
+            for (auto& item : items)
+                item.deleter(item.ptr);
+            items.clear();
+        }
+    };
+
+    // pins the current epoch for the lifetime of the guard
+    class TEpochGuard {
+    public:
+        TEpochGuard() {
+            TEpochDomain::instance().enter();
+        }
+
+        ~TEpochGuard() {
+            TEpochDomain::instance().leave();
+        }
+
+        TEpochGuard(const TEpochGuard&) = delete;
+        TEpochGuard& operator=(const TEpochGuard&) = delete;
+    };
+
+    template <typename T>
+    class TConcurrentTree;
+
+    // Node of a TConcurrentTree. Links are atomic, so readers never block;
+    // writers serialize on a per-node spinlock only when they change that node's children.
+    template <typename T>
+    class TConcurrentNode {
+    public:
+        const T& getValue() const {
+            return value;
+        }
+
+        bool hasLeft() const {
+            return getLeft();
+        }
+
+        bool hasRight() const {
+            return getRight();
+        }
+
+        bool hasParent() const {
+            return getParent();
+        }
+
+        TConcurrentNode* getLeft() const {
+            return left.load(std::memory_order_acquire);
+        }
+
+        TConcurrentNode* getRight() const {
+            return right.load(std::memory_order_acquire);
+        }
+
+        TConcurrentNode* getParent() const {
+            return parent.load(std::memory_order_acquire);
+        }
+
+        // same raw accessors as TNode, so the traversal iterators work under a TEpochGuard
+        TConcurrentNode* getRawLeft() const {
+            return getLeft();
+        }
+
+        TConcurrentNode* getRawRight() const {
+            return getRight();
+        }
+
+        TConcurrentNode* getRawParent() const {
+            return getParent();
+        }
+
+    private:
+        friend class TConcurrentTree<T>;
+
+        const T value;
+        std::atomic<TConcurrentNode*> left{nullptr};
+        std::atomic<TConcurrentNode*> right{nullptr};
+        std::atomic<TConcurrentNode*> parent{nullptr};
+        std::atomic<bool> locked{false};
+
+        explicit TConcurrentNode(T v)
+            : value(std::move(v))
+        {}
+
+        void lock() {
+            while (locked.exchange(true, std::memory_order_acquire)) {
+                while (locked.load(std::memory_order_relaxed))
+                    std::this_thread::yield();
+            }
+        }
+
+        void unlock() {
+            locked.store(false, std::memory_order_release);
+        }
+    };
+
+    // Tree with lock-free readers and per-node locking writers.
+    // Pointers to nodes are valid only while the caller holds a TEpochGuard.
+    // A replaced subtree is retired as a whole and freed after a grace period;
+    // a write that lands in a subtree detached concurrently is lost along with it.
+    template <typename T>
+    class TConcurrentTree {
+    public:
+        using TNode = TConcurrentNode<T>;
+
+        TConcurrentTree() = default;
+
+        explicit TConcurrentTree(T v)
+            : root(new TNode(std::move(v)))
+        {}
+
+        TConcurrentTree(const TConcurrentTree&) = delete;
+        TConcurrentTree& operator=(const TConcurrentTree&) = delete;
+
+        // there must be no readers left
+        ~TConcurrentTree() {
+            destroy(root.load(std::memory_order_relaxed));
+        }
+
+        TNode* getRoot() const {
+            return root.load(std::memory_order_acquire);
+        }
+
+        // a detached node, owned by the caller until it is linked into the tree
+        static TNode* createLeaf(T v) {
+            return new TNode(std::move(v));
+        }
+
+        static TNode* fork(T v, TNode* left, TNode* right) {
+            auto node = new TNode(std::move(v));
+            node->left.store(left, std::memory_order_relaxed);
+            node->right.store(right, std::memory_order_relaxed);
+            if (left)
+                left->parent.store(node, std::memory_order_relaxed);
+            if (right)
+                right->parent.store(node, std::memory_order_relaxed);
+            return node;
+        }
+
+        void replaceRoot(TNode* r) {
+            TEpochGuard guard;
+            std::lock_guard<std::mutex> l(rootGuard);
+            if (r)
+                r->parent.store(nullptr, std::memory_order_relaxed);
+            retire(root.exchange(r, std::memory_order_acq_rel));
+        }
+
+        void replaceLeft(TNode* node, TNode* l) {
+            replaceChild(node, node->left, l);
+        }
+
+        void replaceRight(TNode* node, TNode* r) {
+            replaceChild(node, node->right, r);
+        }
+
+        void replaceLeftWithLeaf(TNode* node, T v) {
+            replaceLeft(node, createLeaf(std::move(v)));
+        }
+
+        void replaceRightWithLeaf(TNode* node, T v) {
+            replaceRight(node, createLeaf(std::move(v)));
+        }
+
+        void removeLeft(TNode* node) {
+            replaceLeft(node, nullptr);
+        }
+
+        void removeRight(TNode* node) {
+            replaceRight(node, nullptr);
+        }
+
+    private:
+        std::atomic<TNode*> root{nullptr};
+        std::mutex rootGuard;
+
+        static void replaceChild(TNode* node, std::atomic<TNode*>& slot, TNode* child) {
+            TEpochGuard guard;
+            node->lock();
+            if (child)
+                child->parent.store(node, std::memory_order_relaxed);
+            auto old = slot.exchange(child, std::memory_order_acq_rel);
+            node->unlock();
+            retire(old);
+        }
+
+        static void retire(TNode* node) {
+            if (node)
+                TEpochDomain::instance().retire(node, [](void* ptr) { destroy(static_cast<TNode*>(ptr)); });
+        }
+
+        static void destroy(TNode* node) {
+            std::vector<TNode*> pending;
+            if (node)
+                pending.push_back(node);
+            while (!pending.empty()) {
+                node = pending.back();
+                pending.pop_back();
+                if (auto l = node->left.load(std::memory_order_relaxed))
+                    pending.push_back(l);
+                if (auto r = node->right.load(std::memory_order_relaxed))
+                    pending.push_back(r);
+                delete node;
+            }
+        }
+    };
+}
@@ -1,8 +1,21 @@
 #include "tree.h"
+#include "arena_tree.h"
+#include "traversal.h"
+#include "reclaimer.h"
+#include "snapshot.h"
+#include "concurrent_tree.h"
+#include "persistent_tree.h"
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <atomic>
+#include <thread>
+#include <vector>
 using bintree::TNode;
 
-int main() {
+void testNode() {
     auto node = TNode<int>::createLeaf(1);
 
     assert(!node->getLeft());
@@ -36,3 +49,324 @@ int main() {
 
     assert(node3->getLeft()->getParent() == node3);
 }
+
+void testArena() {
+    using bintree::TArenaTree;
+    using TIndex = TArenaTree<int>::TIndex;
+
+    TArenaTree<int> tree;
+    TIndex node = tree.createLeaf(1);
+
+    assert(!tree.hasLeft(node));
+    assert(!tree.hasRight(node));
+    assert(tree.getParent(node) == TArenaTree<int>::npos);
+
+    tree.replaceLeftWithLeaf(node, 5);
+    tree.replaceRightWithLeaf(node, 518);
+
+    assert(tree.getValue(tree.getLeft(node)) == 5);
+    assert(tree.getParent(tree.getLeft(node)) == node);
+    assert(tree.getValue(tree.getRight(node)) == 518);
+    assert(tree.getParent(tree.getRight(node)) == node);
+
+    TIndex leaf = tree.createLeaf(4);
+    TIndex node3 = tree.fork(0, node, leaf);
+
+    assert(tree.getValue(node3) == 0);
+    assert(tree.getValue(tree.getLeft(tree.getLeft(node3))) == 5);
+    assert(tree.getValue(tree.getRight(node3)) == 4);
+    assert(tree.getParent(node) == node3);
+
+    TIndex old = tree.removeRight(node3);
+    assert(old == leaf);
+    assert(!tree.hasRight(node3));
+    assert(!tree.hasParent(leaf));
+
+    tree.clear();
+    assert(tree.size() == 0);
+}
+
+template <typename TRangeT>
+std::vector<int> collect(const TRangeT& range) {
+    std::vector<int> values;
+    for (const auto& node : range)
+        values.push_back(node.getValue());
+    return values;
+}
+
+void testTraversal() {
+    // 1 -> (2 -> (4, 5), 3 -> (-, 6))
+    auto root = TNode<int>::createLeaf(1);
+    root->replaceLeftWithLeaf(2);
+    root->replaceRightWithLeaf(3);
+    root->getLeft()->replaceLeftWithLeaf(4);
+    root->getLeft()->replaceRightWithLeaf(5);
+    root->getRight()->replaceRightWithLeaf(6);
+
+    assert((collect(bintree::preOrder(root.get())) == std::vector<int>{1, 2, 4, 5, 3, 6}));
+    assert((collect(bintree::inOrder(root.get())) == std::vector<int>{4, 2, 5, 1, 3, 6}));
+    assert((collect(bintree::postOrder(root.get())) == std::vector<int>{4, 5, 2, 6, 3, 1}));
+    assert((collect(bintree::levelOrder(root.get())) == std::vector<int>{1, 2, 3, 4, 5, 6}));
+
+    // subtree walks stop at their own root
+    const TNode<int>* sub = root->getRawLeft();
+    assert((collect(bintree::preOrder(sub)) == std::vector<int>{2, 4, 5}));
+    assert((collect(bintree::postOrder(sub)) == std::vector<int>{4, 5, 2}));
+
+    TNode<int>* empty = nullptr;
+    assert(collect(bintree::inOrder(empty)).empty());
+    assert(collect(bintree::levelOrder(empty)).empty());
+
+    // degenerate spine
+    auto spine = TNode<int>::createLeaf(0);
+    auto tail = spine.get();
+    for (int i = 1; i < 10000; ++i) {
+        tail->replaceRightWithLeaf(i);
+        tail = tail->getRawRight();
+    }
+    auto values = collect(bintree::inOrder(spine.get()));
+    assert(values.size() == 10000 && values.back() == 9999);
+}
+
+TNode<int>::TNodePtr buildSpine(int depth) {
+    auto spine = TNode<int>::createLeaf(0);
+    auto tail = spine.get();
+    for (int i = 1; i < depth; ++i) {
+        tail->replaceRightWithLeaf(i);
+        tail = tail->getRawRight();
+    }
+    return spine;
+}
+
+void testDestruction() {
+    // would overflow the stack with recursive destructors
+    auto spine = buildSpine(1000000);
+    spine.reset();
+
+    // a shared subtree survives its first owner
+    auto root = TNode<int>::createLeaf(0);
+    root->replaceLeftWithLeaf(1);
+    auto left = root->getLeft();
+    left->replaceLeftWithLeaf(2);
+    root.reset();
+    assert(left->getValue() == 1);
+    assert(left->getRawParent() == nullptr);
+    assert(left->getLeft()->getValue() == 2);
+    assert(left->getLeft()->getParent() == left);
+
+    bintree::TReclaimer<int> reclaimer;
+    auto background = buildSpine(1000000);
+    std::weak_ptr<TNode<int>> watch = background;
+    reclaimer.retire(std::move(background));
+    reclaimer.flush();
+    assert(watch.expired());
+}
+
+void testBulk() {
+    std::vector<int> sorted;
+    for (int i = 0; i < 1000; ++i)
+        sorted.push_back(i);
+
+    auto root = TNode<int>::buildBalanced(sorted.begin(), sorted.end());
+    assert(collect(bintree::inOrder(root.get())) == sorted);
+    assert(root->getLeft()->getParent() == root);
+    int depth = 0;
+    for (auto node = root.get(); node; node = node->getRawLeft())
+        ++depth;
+    assert(depth == 10);
+    assert(!TNode<int>::buildBalanced(sorted.end(), sorted.end()));
+
+    auto buffer = root->serialize();
+    auto copy = TNode<int>::deserialize(buffer.data(), buffer.size());
+    assert(copy);
+    assert(collect(bintree::preOrder(copy.get())) == collect(bintree::preOrder(root.get())));
+    assert(collect(bintree::inOrder(copy.get())) == sorted);
+    assert(copy->getRight()->getParent() == copy);
+
+    // uneven shape
+    auto node = TNode<int>::createLeaf(1);
+    node->replaceRightWithLeaf(2);
+    node->getRight()->replaceLeftWithLeaf(3);
+    buffer = node->serialize();
+    copy = TNode<int>::deserialize(buffer.data(), buffer.size());
+    assert((collect(bintree::preOrder(copy.get())) == std::vector<int>{1, 2, 3}));
+    assert(!copy->hasLeft() && !copy->getRight()->hasRight());
+
+    assert(!TNode<int>::deserialize(buffer.data(), buffer.size() - 1));
+    assert(!TNode<double>::deserialize(buffer.data(), buffer.size()));
+    buffer[16] = 0;
+    assert(!TNode<int>::deserialize(buffer.data(), buffer.size()));
+}
+
+void testSnapshot() {
+    std::vector<int> sorted;
+    for (int i = 0; i < 1000; ++i)
+        sorted.push_back(i);
+    auto root = TNode<int>::buildBalanced(sorted.begin(), sorted.end());
+    root->getRawLeft()->removeRight();
+
+    const std::string path = "snapshot_test.bin";
+    assert(bintree::writeSnapshot(*root, path));
+    {
+        bintree::TSnapshot<int> snapshot(path);
+        assert(snapshot);
+        auto flat = snapshot.root();
+        assert(flat->getValue() == root->getValue());
+        assert(!flat->hasParent());
+        assert(flat->getLeft()->getParent() == flat);
+        assert(flat->getRight()->getRight()->getValue() == root->getRight()->getRight()->getValue());
+        assert(!flat->getLeft()->hasRight());
+        assert(collect(bintree::inOrder(flat)) == collect(bintree::inOrder(root.get())));
+        assert(snapshot.nodeCount() == collect(bintree::inOrder(root.get())).size());
+
+        bintree::TSnapshot<double> mismatched(path);
+        assert(!mismatched);
+    }
+
+    // damaged copies of the file are rejected instead of being followed out of the mapping
+    std::ifstream in(path, std::ios::binary);
+    const std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::string damagedPath = "snapshot_damaged.bin";
+    auto opensDamaged = [&](const std::string& damaged) {
+        std::ofstream(damagedPath, std::ios::binary | std::ios::trunc) << damaged;
+        return bool(bintree::TSnapshot<int>(damagedPath));
+    };
+    assert(opensDamaged(image));
+    assert(!opensDamaged(image.substr(0, image.size() - 1)));
+    assert(!opensDamaged(image + '\0'));
+    std::string corrupted = image;
+    const std::int32_t farLink = 1 << 20;
+    // the root's left link, right after its value
+    std::memcpy(&corrupted[16 + sizeof(int)], &farLink, sizeof(farLink));
+    assert(!opensDamaged(corrupted));
+    corrupted = image;
+    const std::int32_t backLink = -1;
+    std::memcpy(&corrupted[16 + sizeof(int)], &backLink, sizeof(backLink));
+    assert(!opensDamaged(corrupted));
+    // both of the root's links to its left child, which links back to the root either way
+    corrupted = image;
+    std::memcpy(&corrupted[16 + 2 * sizeof(int)], &corrupted[16 + sizeof(int)], sizeof(std::int32_t));
+    assert(!opensDamaged(corrupted));
+    std::remove(damagedPath.c_str());
+    std::remove(path.c_str());
+
+    bintree::TSnapshot<int> missing(path);
+    assert(!missing && !missing.root());
+}
+
+void testConcurrent() {
+    using TTree = bintree::TConcurrentTree<int>;
+    constexpr int writers = 4;
+    constexpr int readers = 4;
+    constexpr int rounds = 20000;
+
+    // every writer owns one child of a fork under the root
+    TTree tree(0);
+    std::vector<TTree::TNode*> owned;
+    for (int w = 0; w < writers; ++w)
+        owned.push_back(TTree::createLeaf(1));
+    tree.replaceLeft(tree.getRoot(), TTree::fork(1, owned[0], owned[1]));
+    tree.replaceRight(tree.getRoot(), TTree::fork(1, owned[2], owned[3]));
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&] {
+            while (!stop) {
+                bintree::TEpochGuard guard;
+                for (auto& node : bintree::preOrder(tree.getRoot())) {
+                    assert(node.getValue() >= 0);
+                    if (auto left = node.getLeft())
+                        assert(left->getParent() == &node);
+                }
+            }
+        });
+    }
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            auto node = owned[w];
+            for (int i = 0; i < rounds; ++i) {
+                tree.replaceLeft(node, TTree::fork(i, TTree::createLeaf(i), nullptr));
+                tree.replaceRightWithLeaf(node, i);
+                if (i % 3 == 0)
+                    tree.removeRight(node);
+            }
+        });
+    }
+    for (int w = 0; w < writers; ++w)
+        threads[readers + w].join();
+    stop = true;
+    for (int r = 0; r < readers; ++r)
+        threads[r].join();
+
+    // more threads pinned at once than a chunk of epoch slots holds
+    constexpr int crowd = 300;
+    std::atomic<int> pinned{0};
+    std::vector<std::thread> crowdThreads;
+    for (int t = 0; t < crowd; ++t) {
+        crowdThreads.emplace_back([&] {
+            bintree::TEpochGuard guard;
+            ++pinned;
+            while (pinned < crowd)
+                std::this_thread::yield();
+        });
+    }
+    for (auto& thread : crowdThreads)
+        thread.join();
+
+    bintree::TEpochGuard guard;
+    for (auto node : owned) {
+        assert(node->getLeft()->getValue() == rounds - 1);
+        assert(node->getLeft()->getLeft()->getValue() == rounds - 1);
+        assert(node->getRight()->getValue() == rounds - 1);
+    }
+}
+
+void testPersistent() {
+    using TPNode = bintree::TPersistentNode<int>;
+    using bintree::EDirection;
+
+    std::vector<int> sorted{0, 1, 2, 3, 4, 5, 6};
+    auto v1 = TPNode::buildBalanced(sorted.begin(), sorted.end());
+    assert(v1->getValue() == 3);
+    assert(v1->getLeft()->getValue() == 1);
+    assert(v1->getRight()->getRight()->getValue() == 6);
+
+    const bintree::TPath path{EDirection::Left, EDirection::Right};
+    auto v2 = TPNode::setValueAt(v1, path, 20);
+    assert(TPNode::find(v1, path)->getValue() == 2);
+    assert(TPNode::find(v2, path)->getValue() == 20);
+    // only the path is copied
+    assert(v1 != v2 && v1->getLeft() != v2->getLeft());
+    assert(v1->getRight() == v2->getRight());
+    assert(v1->getLeft()->getLeft() == v2->getLeft()->getLeft());
+
+    auto v3 = TPNode::replaceAt(v2, {EDirection::Right}, nullptr);
+    assert(!v3->hasRight() && v2->hasRight());
+    assert(v3->getLeft() == v2->getLeft());
+
+    auto v4 = TPNode::replaceAt(v3, {EDirection::Right, EDirection::Left}, TPNode::createLeaf(9));
+    assert(v4 == v3);
+    assert(TPNode::setValueAt(v3, {EDirection::Right}, 1) == v3);
+
+    // old versions survive newer ones
+    v1.reset();
+    assert(v2->getRight()->getValue() == 5);
+
+    // deep versions are torn down without recursion
+    auto spine = TPNode::createLeaf(0);
+    for (int i = 1; i < 1000000; ++i)
+        spine = TPNode::fork(i, nullptr, std::move(spine));
+    spine.reset();
+}
+
+int main() {
+    testNode();
+    testArena();
+    testTraversal();
+    testDestruction();
+    testBulk();
+    testSnapshot();
+    testConcurrent();
+    testPersistent();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace bintree {
+    enum class EDirection {
+        Left,
+        Right,
+    };
+
+    using TPath = std::vector<EDirection>;
+
+    // Immutable node without a parent link. Every update copies the root-to-node path
+    // and shares all the other subtrees with the previous version, so versions are cheap to keep
+    // and, being immutable, can be read from any thread without locks.
+    template <typename T>
+    class TPersistentNode {
+    public:
+        using TNodePtr = std::shared_ptr<const TPersistentNode>;
+
+        bool hasLeft() const {
+            return bool(left);
+        }
+
+        bool hasRight() const {
+            return bool(right);
+        }
+
+        const T& getValue() const {
+            return value;
+        }
+
+        const TNodePtr& getLeft() const {
+            return left;
+        }
+
+        const TNodePtr& getRight() const {
+            return right;
+        }
+
+        static TNodePtr createLeaf(T v) {
+            return std::make_shared<TPersistentNode>(std::move(v), nullptr, nullptr);
+        }
+
+        static TNodePtr fork(T v, TNodePtr left, TNodePtr right) {
+            return std::make_shared<TPersistentNode>(std::move(v), std::move(left), std::move(right));
+        }
+
+        // balanced tree over a sorted range, consumed in order
+        template <typename TForwardIt>
+        static TNodePtr buildBalanced(TForwardIt first, TForwardIt last) {
+            return buildBalancedPrefix(first, size_t(std::distance(first, last)));
+        }
+
+        TNodePtr withValue(T v) const {
+            return fork(std::move(v), left, right);
+        }
+
+        TNodePtr withLeft(TNodePtr l) const {
+            return fork(value, std::move(l), right);
+        }
+
+        TNodePtr withRight(TNodePtr r) const {
+            return fork(value, left, std::move(r));
+        }
+
+        // the node at the end of path, nullptr if the path leaves the tree
+        static const TPersistentNode* find(const TNodePtr& root, const TPath& path) {
+            auto node = root.get();
+            for (auto it = path.begin(); node && it != path.end(); ++it)
+                node = (*it == EDirection::Left ? node->left : node->right).get();
+            return node;
+        }
+
+        // new version with the subtree at the end of path replaced;
+        // every node on the path but the last one must exist, otherwise root is returned unchanged
+        static TNodePtr replaceAt(const TNodePtr& root, const TPath& path, TNodePtr subtree) {
+            std::vector<const TPersistentNode*> nodes;
+            auto node = root.get();
+            for (auto direction : path) {
+                if (!node)
+                    return root;
+                nodes.push_back(node);
+                node = (direction == EDirection::Left ? node->left : node->right).get();
+            }
+            for (size_t i = nodes.size(); i-- > 0;) {
+                subtree = path[i] == EDirection::Left
+                    ? nodes[i]->withLeft(std::move(subtree))
+                    : nodes[i]->withRight(std::move(subtree));
+            }
+            return subtree;
+        }
+
+        // new version with the value at the end of path replaced, root is returned unchanged if there is no such node
+        static TNodePtr setValueAt(const TNodePtr& root, const TPath& path, T v) {
+            auto node = find(root, path);
+            if (!node)
+                return root;
+            return replaceAt(root, path, node->withValue(std::move(v)));
+        }
+
+        TPersistentNode(T v, TNodePtr left, TNodePtr right)
+            : value(std::move(v))
+            , left(std::move(left))
+            , right(std::move(right))
+        {}
+
+        // same worklist teardown as TNode, deep versions mustn't overflow the stack
+        ~TPersistentNode() {
+            std::vector<TNodePtr> pending;
+            detachChildren(pending);
+            while (!pending.empty()) {
+                auto node = std::move(pending.back());
+                pending.pop_back();
+                // nodes are created mutable by make_shared and no one else can see this one anymore
+                if (node.use_count() == 1)
+                    const_cast<TPersistentNode&>(*node).detachChildren(pending);
+            }
+        }
+
+    private:
+        T value;
+        TNodePtr left;
+        TNodePtr right;
+
+        void detachChildren(std::vector<TNodePtr>& pending) {
+            for (auto child : {&left, &right}) {
+                if (child->use_count() == 1)
+                    pending.push_back(std::move(*child));
+                else
+                    child->reset();
+            }
+        }
+
+        template <typename TForwardIt>
+        static TNodePtr buildBalancedPrefix(TForwardIt& first, size_t count) {
+            if (count == 0)
+                return nullptr;
+            const size_t leftCount = count / 2;
+            auto l = buildBalancedPrefix(first, leftCount);
+            T v = *first;
+            ++first;
+            auto r = buildBalancedPrefix(first, count - leftCount - 1);
+            return fork(std::move(v), std::move(l), std::move(r));
+        }
+    };
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "tree.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bintree {
+    // Releases retired trees on a background thread, so the caller doesn't pay for freeing them.
+    // Retired trees are taken in batches; the destructor drains whatever is still queued.
+    template <typename T>
+    class TReclaimer {
+    public:
+        using TNodePtr = typename TNode<T>::TNodePtr;
+
+        TReclaimer()
+            : worker([this] { run(); })
+        {}
+
+        TReclaimer(const TReclaimer&) = delete;
+        TReclaimer& operator=(const TReclaimer&) = delete;
+
+        ~TReclaimer() {
+            {
+                std::lock_guard<std::mutex> l(guard);
+                stopped = true;
+            }
+            cvar.notify_one();
+            worker.join();
+        }
+
+        // the tree is freed on the worker thread once no one else holds a reference to its root
+        void retire(TNodePtr root) {
+            if (!root)
+                return;
+            {
+                std::lock_guard<std::mutex> l(guard);
+                retired.push_back(std::move(root));
+            }
+            cvar.notify_one();
+        }
+
+        // blocks until everything retired so far is released
+        void flush() {
+            std::unique_lock<std::mutex> l(guard);
+            drained.wait(l, [this] { return retired.empty() && !busy; });
+        }
+
+    private:
+        std::mutex guard;
+        std::condition_variable cvar;
+        std::condition_variable drained;
+        std::vector<TNodePtr> retired;
+        bool stopped = false;
+        bool busy = false;
+        std::thread worker;
+
+        void run() {
+            std::vector<TNodePtr> batch;
+            std::unique_lock<std::mutex> l(guard);
+            while (true) {
+                cvar.wait(l, [this] { return stopped || !retired.empty(); });
+                if (retired.empty() && stopped)
+                    return;
+                batch.swap(retired);
+                busy = true;
+                l.unlock();
+                batch.clear();
+                l.lock();
+                busy = false;
+                if (retired.empty())
+                    drained.notify_all();
+            }
+        }
+    };
+}
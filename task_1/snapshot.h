@@ -0,0 +1,214 @@
+#pragma once
+
+#include "tree.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bintree {
+    // Read-only node of a flat snapshot. Links are offsets relative to the node itself,
+    // so the image is pointer-free and can be mapped at any address and shared between processes.
+    template <typename T>
+    struct TSnapshotNode {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshots need trivially copyable values");
+
+        bool hasLeft() const {
+            return left != 0;
+        }
+
+        bool hasRight() const {
+            return right != 0;
+        }
+
+        bool hasParent() const {
+            return parent != 0;
+        }
+
+        const T& getValue() const {
+            return value;
+        }
+
+        const TSnapshotNode* getLeft() const {
+            return follow(left);
+        }
+
+        const TSnapshotNode* getRight() const {
+            return follow(right);
+        }
+
+        const TSnapshotNode* getParent() const {
+            return follow(parent);
+        }
+
+        // same raw accessors as TNode, so the traversal iterators work on snapshots
+        const TSnapshotNode* getRawLeft() const {
+            return follow(left);
+        }
+
+        const TSnapshotNode* getRawRight() const {
+            return follow(right);
+        }
+
+        const TSnapshotNode* getRawParent() const {
+            return follow(parent);
+        }
+
+        T value;
+        // distance in nodes, 0 when there is no link
+        std::int32_t left;
+        std::int32_t right;
+        std::int32_t parent;
+
+    private:
+        const TSnapshotNode* follow(std::int32_t offset) const {
+            return offset ? this + offset : nullptr;
+        }
+    };
+
+    // Snapshot file: "BTS1", uint32 sizeof(T), uint64 node count, then nodes in level order.
+    // Level order keeps the top of the tree, which every lookup touches, in the first few pages.
+    template <typename T>
+    bool writeSnapshot(const TNode<T>& root, const std::string& path) {
+        using TFlat = TSnapshotNode<T>;
+
+        std::vector<const TNode<T>*> order{&root};
+        std::vector<TFlat> nodes(1);
+        nodes[0].parent = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (order.size() > size_t(INT32_MAX))
+                return false;
+            std::memcpy(&nodes[i].value, &order[i]->getValue(), sizeof(T));
+            auto place = [&](const TNode<T>* child) {
+                if (!child)
+                    return std::int32_t(0);
+                auto offset = std::int32_t(order.size() - i);
+                order.push_back(child);
+                nodes.emplace_back();
+                nodes.back().parent = -offset;
+                return offset;
+            };
+            nodes[i].left = place(order[i]->getRawLeft());
+            nodes[i].right = place(order[i]->getRawRight());
+        }
+
+        char header[16];
+        const std::uint32_t valueSize = sizeof(T);
+        const std::uint64_t count = nodes.size();
+        std::memcpy(header, "BTS1", 4);
+        std::memcpy(header + 4, &valueSize, 4);
+        std::memcpy(header + 8, &count, 8);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(header, sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(TFlat));
+        return bool(out);
+    }
+
+    // Maps a snapshot file read-only. An invalid or missing file yields an empty snapshot.
+    // Opening checks every link once, so a truncated or corrupted file can't make a traversal
+    // leave the mapping or loop: children must come later in the array and link back to their parent,
+    // and a node's two links can't lead to the same child.
+    template <typename T>
+    class TSnapshot {
+    public:
+        using TFlat = TSnapshotNode<T>;
+
+        explicit TSnapshot(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= headerSize) {
+                size = st.st_size;
+                void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                data = addr == MAP_FAILED ? nullptr : static_cast<const char*>(addr);
+            }
+            ::close(fd);
+            if (data && !validate())
+                unmap();
+        }
+
+        TSnapshot(TSnapshot&& rhs)
+            : data(rhs.data)
+            , size(rhs.size)
+            , count(rhs.count)
+        {
+            rhs.data = nullptr;
+        }
+
+        TSnapshot& operator=(TSnapshot&& rhs) {
+            std::swap(data, rhs.data);
+            std::swap(size, rhs.size);
+            std::swap(count, rhs.count);
+            return *this;
+        }
+
+        ~TSnapshot() {
+            unmap();
+        }
+
+        explicit operator bool() const {
+            return data;
+        }
+
+        size_t nodeCount() const {
+            return data ? count : 0;
+        }
+
+        const TFlat* root() const {
+            return data ? reinterpret_cast<const TFlat*>(data + headerSize) : nullptr;
+        }
+
+    private:
+        static constexpr size_t headerSize = 16;
+
+        const char* data = nullptr;
+        size_t size = 0;
+        std::uint64_t count = 0;
+
+        bool validate() {
+            std::uint32_t valueSize = 0;
+            std::memcpy(&valueSize, data + 4, 4);
+            std::memcpy(&count, data + 8, 8);
+            if (std::memcmp(data, "BTS1", 4) != 0
+                || valueSize != sizeof(T)
+                || count == 0
+                || count > size_t(INT32_MAX)
+                || (size - headerSize) % sizeof(TFlat) != 0
+                || (size - headerSize) / sizeof(TFlat) != count)
+                return false;
+            const TFlat* nodes = root();
+            if (nodes[0].parent != 0)
+                return false;
+            for (std::uint64_t i = 0; i < count; ++i) {
+                if (nodes[i].left != 0 && nodes[i].left == nodes[i].right)
+                    return false;
+                for (std::int32_t child : {nodes[i].left, nodes[i].right}) {
+                    if (child == 0)
+                        continue;
+                    if (child < 0 || std::uint64_t(child) >= count - i || nodes[i + child].parent != -child)
+                        return false;
+                }
+                const std::int32_t parent = nodes[i].parent;
+                if (i > 0 && (parent >= 0 || std::uint64_t(-std::int64_t(parent)) > i))
+                    return false;
+            }
+            return true;
+        }
+
+        void unmap() {
+            if (data)
+                ::munmap(const_cast<char*>(data), size);
+            data = nullptr;
+        }
+    };
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "tree.h"
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <type_traits>
+
+namespace bintree {
+    // Depth-first iterators walk raw child links and climb back through the parent link,
+    // so a step costs neither an allocation nor a refcount update and recursion depth is not an issue.
+    // They stop at the node they were started from, which lets them traverse any subtree.
+    // Climbing assumes every node's parent link points back into the traversed tree:
+    // a subtree later shared into another tree by fork() is reparented and can't be walked from its old root.
+    namespace traversal {
+        template <typename TNodeT>
+        TNodeT* leftmost(TNodeT* node) {
+            while (node->getRawLeft())
+                node = node->getRawLeft();
+            return node;
+        }
+
+        // first node of a postorder walk: the deepest node reached preferring left children
+        template <typename TNodeT>
+        TNodeT* firstLeaf(TNodeT* node) {
+            while (true) {
+                if (node->getRawLeft())
+                    node = node->getRawLeft();
+                else if (node->getRawRight())
+                    node = node->getRawRight();
+                else
+                    return node;
+            }
+        }
+
+        struct TPreOrder {
+            template <typename TNodeT>
+            static TNodeT* first(TNodeT* root) {
+                return root;
+            }
+
+            template <typename TNodeT>
+            static TNodeT* next(TNodeT* node, TNodeT* root) {
+                if (node->getRawLeft())
+                    return node->getRawLeft();
+                if (node->getRawRight())
+                    return node->getRawRight();
+                while (node != root) {
+                    auto parent = node->getRawParent();
+                    if (node == parent->getRawLeft() && parent->getRawRight())
+                        return parent->getRawRight();
+                    node = parent;
+                }
+                return nullptr;
+            }
+        };
+
+        struct TInOrder {
+            template <typename TNodeT>
+            static TNodeT* first(TNodeT* root) {
+                return root ? leftmost(root) : nullptr;
+            }
+
+            template <typename TNodeT>
+            static TNodeT* next(TNodeT* node, TNodeT* root) {
+                if (node->getRawRight())
+                    return leftmost(node->getRawRight());
+                while (node != root) {
+                    auto parent = node->getRawParent();
+                    if (node == parent->getRawLeft())
+                        return parent;
+                    node = parent;
+                }
+                return nullptr;
+            }
+        };
+
+        struct TPostOrder {
+            template <typename TNodeT>
+            static TNodeT* first(TNodeT* root) {
+                return root ? firstLeaf(root) : nullptr;
+            }
+
+            template <typename TNodeT>
+            static TNodeT* next(TNodeT* node, TNodeT* root) {
+                if (node == root)
+                    return nullptr;
+                auto parent = node->getRawParent();
+                if (node == parent->getRawLeft() && parent->getRawRight())
+                    return firstLeaf(parent->getRawRight());
+                return parent;
+            }
+        };
+    }
+
+    template <typename TNodeT, typename TOrder>
+    class TDepthFirstIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::remove_const_t<TNodeT>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = TNodeT*;
+        using reference = TNodeT&;
+
+        TDepthFirstIterator() = default;
+
+        TDepthFirstIterator(TNodeT* node, TNodeT* root)
+            : node(node)
+            , root(root)
+        {}
+
+        reference operator*() const {
+            return *node;
+        }
+
+        pointer operator->() const {
+            return node;
+        }
+
+        TDepthFirstIterator& operator++() {
+            node = TOrder::next(node, root);
+            return *this;
+        }
+
+        TDepthFirstIterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const TDepthFirstIterator& rhs) const {
+            return node == rhs.node;
+        }
+
+        bool operator!=(const TDepthFirstIterator& rhs) const {
+            return node != rhs.node;
+        }
+
+    private:
+        TNodeT* node = nullptr;
+        TNodeT* root = nullptr;
+    };
+
+    // Breadth-first walk needs a frontier; it lives in a deque owned by the iterator,
+    // which grows in chunks rather than per step. Copies are expensive, so it is a single-pass iterator.
+    template <typename TNodeT>
+    class TLevelOrderIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::remove_const_t<TNodeT>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = TNodeT*;
+        using reference = TNodeT&;
+
+        TLevelOrderIterator() = default;
+
+        explicit TLevelOrderIterator(TNodeT* root) {
+            if (root)
+                frontier.push_back(root);
+        }
+
+        reference operator*() const {
+            return *frontier.front();
+        }
+
+        pointer operator->() const {
+            return frontier.front();
+        }
+
+        TLevelOrderIterator& operator++() {
+            auto node = frontier.front();
+            frontier.pop_front();
+            if (node->getRawLeft())
+                frontier.push_back(node->getRawLeft());
+            if (node->getRawRight())
+                frontier.push_back(node->getRawRight());
+            return *this;
+        }
+
+        bool operator==(const TLevelOrderIterator& rhs) const {
+            return current() == rhs.current();
+        }
+
+        bool operator!=(const TLevelOrderIterator& rhs) const {
+            return !(*this == rhs);
+        }
+
+    private:
+        std::deque<TNodeT*> frontier;
+
+        TNodeT* current() const {
+            return frontier.empty() ? nullptr : frontier.front();
+        }
+    };
+
+    template <typename TIterator>
+    class TRange {
+    public:
+        TRange(TIterator first, TIterator last)
+            : first(std::move(first))
+            , last(std::move(last))
+        {}
+
+        TIterator begin() const {
+            return first;
+        }
+
+        TIterator end() const {
+            return last;
+        }
+
+    private:
+        TIterator first;
+        TIterator last;
+    };
+
+    template <typename TNodeT>
+    using TPreOrderIterator = TDepthFirstIterator<TNodeT, traversal::TPreOrder>;
+    template <typename TNodeT>
+    using TInOrderIterator = TDepthFirstIterator<TNodeT, traversal::TInOrder>;
+    template <typename TNodeT>
+    using TPostOrderIterator = TDepthFirstIterator<TNodeT, traversal::TPostOrder>;
+
+    template <typename TNodeT, typename TOrder>
+    TRange<TDepthFirstIterator<TNodeT, TOrder>> depthFirst(TNodeT* root) {
+        using TIterator = TDepthFirstIterator<TNodeT, TOrder>;
+        return {TIterator(TOrder::first(root), root), TIterator()};
+    }
+
+    template <typename TNodeT>
+    TRange<TPreOrderIterator<TNodeT>> preOrder(TNodeT* root) {
+        return depthFirst<TNodeT, traversal::TPreOrder>(root);
+    }
+
+    template <typename TNodeT>
+    TRange<TInOrderIterator<TNodeT>> inOrder(TNodeT* root) {
+        return depthFirst<TNodeT, traversal::TInOrder>(root);
+    }
+
+    template <typename TNodeT>
+    TRange<TPostOrderIterator<TNodeT>> postOrder(TNodeT* root) {
+        return depthFirst<TNodeT, traversal::TPostOrder>(root);
+    }
+
+    template <typename TNodeT>
+    TRange<TLevelOrderIterator<TNodeT>> levelOrder(TNodeT* root) {
+        return {TLevelOrderIterator<TNodeT>(root), TLevelOrderIterator<TNodeT>()};
+    }
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace bintree {
     template <typename T>
@@ -53,6 +58,31 @@ namespace bintree {
             return parent.lock();
         }
 
+        // raw links for traversal, no refcount traffic
+        TNode* getRawLeft() {
+            return left.get();
+        }
+
+        const TNode* getRawLeft() const {
+            return left.get();
+        }
+
+        TNode* getRawRight() {
+            return right.get();
+        }
+
+        const TNode* getRawRight() const {
+            return right.get();
+        }
+
+        TNode* getRawParent() {
+            return rawParent;
+        }
+
+        const TNode* getRawParent() const {
+            return rawParent;
+        }
+
         static TNodePtr createLeaf(T v) {
             auto obj = new TNode(v);
             auto ptr = std::shared_ptr<TNode>(obj);
@@ -67,6 +97,101 @@ namespace bintree {
             return ptr;
         }
 
+        // balanced tree over a sorted range, built in one in-order pass without shared_from_this
+        template <typename TForwardIt>
+        static TNodePtr buildBalanced(TForwardIt first, TForwardIt last) {
+            return buildBalancedPrefix(first, size_t(std::distance(first, last)));
+        }
+
+        // Snapshot layout, native byte order:
+        //   "BTN1", uint32 sizeof(T), uint64 node count,
+        //   2 shape bits per node in preorder (has left, has right), padded to a byte,
+        //   node values in preorder.
+        std::vector<char> serialize() const {
+            static_assert(std::is_trivially_copyable<T>::value, "serialize needs trivially copyable values");
+
+            std::vector<const TNode*> order;
+            std::vector<const TNode*> stack{this};
+            while (!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+                order.push_back(node);
+                if (node->right)
+                    stack.push_back(node->right.get());
+                if (node->left)
+                    stack.push_back(node->left.get());
+            }
+
+            const std::uint64_t count = order.size();
+            const size_t shapeSize = (2 * count + 7) / 8;
+            std::vector<char> buffer(headerSize + shapeSize + count * sizeof(T));
+            writeHeader(buffer.data(), count);
+
+            auto shape = reinterpret_cast<unsigned char*>(buffer.data() + headerSize);
+            auto values = buffer.data() + headerSize + shapeSize;
+            for (size_t i = 0; i < count; ++i) {
+                if (order[i]->left)
+                    shape[2 * i / 8] |= 1u << (2 * i % 8);
+                if (order[i]->right)
+                    shape[(2 * i + 1) / 8] |= 1u << ((2 * i + 1) % 8);
+                std::memcpy(values + i * sizeof(T), &order[i]->value, sizeof(T));
+            }
+            return buffer;
+        }
+
+        // returns nullptr on a malformed buffer
+        static TNodePtr deserialize(const char* data, size_t size) {
+            static_assert(std::is_trivially_copyable<T>::value, "deserialize needs trivially copyable values");
+
+            std::uint64_t count = 0;
+            if (!readHeader(data, size, count) || count == 0 || count > size)
+                return nullptr;
+            const size_t shapeSize = (2 * count + 7) / 8;
+            if (size - headerSize < shapeSize || (size - headerSize - shapeSize) / sizeof(T) < count)
+                return nullptr;
+
+            auto shape = reinterpret_cast<const unsigned char*>(data + headerSize);
+            auto values = data + headerSize + shapeSize;
+
+            struct TPending {
+                TNode* node;
+                bool wantsLeft;
+                bool wantsRight;
+            };
+            std::vector<TPending> stack;
+            TNodePtr root;
+            for (size_t i = 0; i < count; ++i) {
+                T v;
+                std::memcpy(&v, values + i * sizeof(T), sizeof(T));
+                TNodePtr node(new TNode(v));
+                auto raw = node.get();
+
+                if (i == 0) {
+                    root = std::move(node);
+                } else if (stack.empty()) {
+                    return nullptr;
+                } else {
+                    auto& top = stack.back();
+                    auto parent = top.node;
+                    if (top.wantsLeft) {
+                        top.wantsLeft = false;
+                        link(parent, parent->left, std::move(node));
+                    } else {
+                        top.wantsRight = false;
+                        link(parent, parent->right, std::move(node));
+                    }
+                    if (!top.wantsLeft && !top.wantsRight)
+                        stack.pop_back();
+                }
+
+                bool hasLeft = shape[2 * i / 8] >> (2 * i % 8) & 1;
+                bool hasRight = shape[(2 * i + 1) / 8] >> ((2 * i + 1) % 8) & 1;
+                if (hasLeft || hasRight)
+                    stack.push_back({raw, hasLeft, hasRight});
+            }
+            return stack.empty() ? root : nullptr;
+        }
+
         TNodePtr replaceLeft(TNodePtr l) {
             setParent(l, this->shared_from_this());
             setParent(left, nullptr);
@@ -96,11 +221,26 @@ namespace bintree {
             return replaceRight(nullptr);
         }
 
+        // Destroying a subtree recursively costs a stack frame per level, which overflows on deep trees.
+        // Instead, children owned only by this node are moved to a local worklist and released one by one,
+        // each of them arriving at its own destructor already childless.
+        ~TNode() {
+            std::vector<TNodePtr> pending;
+            detachChildren(pending);
+            while (!pending.empty()) {
+                auto node = std::move(pending.back());
+                pending.pop_back();
+                if (node.use_count() == 1)
+                    node->detachChildren(pending);
+            }
+        }
+
     private:
         T value;
         TNodePtr left = nullptr;
         TNodePtr right = nullptr;
         TNodeWeakPtr parent;
+        TNode* rawParent = nullptr;
 
         TNode(T v)
             : value(v)
@@ -114,9 +254,69 @@ namespace bintree {
             , right(right ? right->shared_from_this() : TNodePtr{nullptr})
         {}
 
+        static constexpr size_t headerSize = 16;
+
+        static void writeHeader(char* data, std::uint64_t count) {
+            const std::uint32_t valueSize = sizeof(T);
+            std::memcpy(data, "BTN1", 4);
+            std::memcpy(data + 4, &valueSize, 4);
+            std::memcpy(data + 8, &count, 8);
+        }
+
+        static bool readHeader(const char* data, size_t size, std::uint64_t& count) {
+            std::uint32_t valueSize = 0;
+            if (size < headerSize || std::memcmp(data, "BTN1", 4) != 0)
+                return false;
+            std::memcpy(&valueSize, data + 4, 4);
+            std::memcpy(&count, data + 8, 8);
+            return valueSize == sizeof(T);
+        }
+
+        // parent is known to be owned by a shared_ptr, but linking mustn't pay for shared_from_this
+        static void link(TNode* parent, TNodePtr& slot, TNodePtr child) {
+            child->rawParent = parent;
+            child->parent = parent->weak_from_this();
+            slot = std::move(child);
+        }
+
+        template <typename TForwardIt>
+        static TNodePtr buildBalancedPrefix(TForwardIt& first, size_t count) {
+            if (count == 0)
+                return nullptr;
+            const size_t leftCount = count / 2;
+            auto left = buildBalancedPrefix(first, leftCount);
+            TNodePtr node(new TNode(*first));
+            ++first;
+            auto right = buildBalancedPrefix(first, count - leftCount - 1);
+            if (left)
+                link(node.get(), node->left, std::move(left));
+            if (right)
+                link(node.get(), node->right, std::move(right));
+            return node;
+        }
+
+        void detachChildren(std::vector<TNodePtr>& pending) {
+            detachChild(left, pending);
+            detachChild(right, pending);
+        }
+
+        void detachChild(TNodePtr& child, std::vector<TNodePtr>& pending) {
+            if (!child)
+                return;
+            // children may outlive us, don't leave them a dangling raw parent
+            if (child->rawParent == this)
+                child->rawParent = nullptr;
+            if (child.use_count() == 1)
+                pending.push_back(std::move(child));
+            else
+                child.reset();
+        }
+
         static void setParent(TNodePtr node, TNodePtr parent) {
-            if (node)
+            if (node) {
                 node->parent = parent;
+                node->rawParent = parent.get();
+            }
         }
     };
 }
\ No newline at end of file
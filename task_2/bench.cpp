@@ -0,0 +1,275 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "generators.h"
+
+// g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// ./bench [section]
+
+using TClock = std::chrono::steady_clock;
+
+constexpr size_t num_samples = 10000000;
+constexpr size_t batch_size = 1024;
+
+double seconds_since(TClock::time_point start)
+{
+    return std::chrono::duration<double>(TClock::now() - start).count();
+}
+
+void report(const std::string& name, size_t samples, double seconds, double checksum)
+{
+    std::cout << name << ": " << samples / seconds / 1e6 << " Msamples/s (checksum " << checksum << ")" << std::endl;
+}
+
+void benchScalarVsBatch(const std::string& name, const BaseRNG& rng)
+{
+    auto start = TClock::now();
+    auto sum = 0.0;
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        sum += rng.generate();
+    }
+    report(name + " scalar", num_samples, seconds_since(start), sum);
+
+    std::vector<double> batch(batch_size);
+    start = TClock::now();
+    sum = 0.0;
+    for (size_t i = 0; i < num_samples; i += batch_size)
+    {
+        rng.generate(batch.data(), batch.size());
+        for (auto value : batch)
+        {
+            sum += value;
+        }
+    }
+    report(name + " batch", num_samples, seconds_since(start), sum);
+}
+
+void benchBatch()
+{
+    auto f = Factory();
+    benchScalarVsBatch("poisson", *f.create("poisson", std::make_unique<PoissonRNGOpts>(4.0)));
+    benchScalarVsBatch("bernoulli", *f.create("bernoulli", std::make_unique<BernoulliRNGOpts>(0.3)));
+    benchScalarVsBatch("geometric", *f.create("geometric", std::make_unique<GeometricRNGOpts>(0.2)));
+    benchScalarVsBatch("finite", *f.create("finite", std::make_unique<FiniteRNGOpts>(
+        std::vector<double>{0.2, 0.3, 0.3, 0.2}, std::vector<double>{0, 1, 2, 3})));
+}
+
+void benchAlias()
+{
+    auto f = Factory();
+    std::default_random_engine engine(42);
+    std::uniform_real_distribution<double> weight(0.0, 1.0);
+
+    for (size_t size : {10, 1000, 100000, 1000000})
+    {
+        std::vector<double> probs(size), values(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            probs[i] = weight(engine);
+            values[i] = i;
+        }
+        auto total = std::accumulate(probs.begin(), probs.end(), 0.0);
+        for (auto& prob : probs)
+        {
+            prob /= total;
+        }
+
+        for (const std::string name : {"finite", "finite_alias"})
+        {
+            auto start = TClock::now();
+            auto rng = f.create(name, std::make_unique<FiniteRNGOpts>(probs, values));
+            auto build = seconds_since(start);
+
+            std::vector<double> batch(batch_size);
+            start = TClock::now();
+            auto sum = 0.0;
+            for (size_t i = 0; i < num_samples; i += batch_size)
+            {
+                rng->generate(batch.data(), batch.size());
+                sum = std::accumulate(batch.begin(), batch.end(), sum);
+            }
+            report(name + " n=" + std::to_string(size) + " (build " + std::to_string(build * 1000) + " ms)",
+                num_samples, seconds_since(start), sum);
+        }
+    }
+}
+
+void benchParallel()
+{
+    auto f = Factory();
+    auto rng = f.create("poisson", std::make_unique<PoissonRNGOpts>(4.0));
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        std::vector<double> sums(num_threads);
+        std::vector<std::thread> threads;
+        auto start = TClock::now();
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            threads.emplace_back([&, t]() {
+                auto stream = rng->stream(t);
+                std::vector<double> batch(batch_size);
+                auto sum = 0.0;
+                for (size_t i = 0; i < num_samples; i += batch_size)
+                {
+                    rng->generate(stream, batch.data(), batch.size());
+                    sum = std::accumulate(batch.begin(), batch.end(), sum);
+                }
+                sums[t] = sum;
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        report("poisson, " + std::to_string(num_threads) + " threads", num_threads * num_samples,
+            seconds_since(start), std::accumulate(sums.begin(), sums.end(), 0.0));
+    }
+}
+
+void benchDispatch()
+{
+    auto f = Factory();
+    auto virtualRng = f.create("bernoulli", std::make_unique<BernoulliRNGOpts>(0.3));
+    auto variantRng = f.createVariant("bernoulli", std::make_unique<BernoulliRNGOpts>(0.3));
+    auto staticRng = Factory::make<BernoulliRNG>(std::make_unique<BernoulliRNGOpts>(0.3));
+
+    auto start = TClock::now();
+    auto sum = 0.0;
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        sum += virtualRng->generate();
+    }
+    report("bernoulli virtual", num_samples, seconds_since(start), sum);
+
+    start = TClock::now();
+    sum = 0.0;
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        sum += generate(*variantRng);
+    }
+    report("bernoulli variant", num_samples, seconds_since(start), sum);
+
+    start = TClock::now();
+    sum = 0.0;
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        sum += staticRng->generate();
+    }
+    report("bernoulli static", num_samples, seconds_since(start), sum);
+}
+
+template <typename TEngine>
+void benchEngine(const std::string& name)
+{
+    TEngine engine(42);
+    auto start = TClock::now();
+    uint64_t bits = 0;
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        bits ^= engine();
+    }
+    report(name + " raw", num_samples, seconds_since(start), double(bits & 0xffff));
+
+    auto f = Factory();
+    auto suffix = name == "default" ? std::string() : ":" + name;
+    auto rng = f.create("geometric" + suffix, std::make_unique<GeometricRNGOpts>(0.2));
+    std::vector<double> batch(batch_size);
+    start = TClock::now();
+    auto sum = 0.0;
+    for (size_t i = 0; i < num_samples; i += batch_size)
+    {
+        rng->generate(batch.data(), batch.size());
+        sum = std::accumulate(batch.begin(), batch.end(), sum);
+    }
+    report(name + " geometric batch", num_samples, seconds_since(start), sum);
+}
+
+void benchEngines()
+{
+    benchEngine<std::default_random_engine>("default");
+    benchEngine<Xoshiro256ss>("xoshiro256ss");
+    benchEngine<Pcg64>("pcg64");
+    benchEngine<SplitMix64>("splitmix64");
+    benchEngine<Philox4x32>("philox4x32");
+}
+
+template <typename TDistribution>
+void benchStd(const std::string& name, TDistribution distribution)
+{
+    std::default_random_engine engine(42);
+    auto start = TClock::now();
+    auto sum = 0.0;
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        sum += distribution(engine);
+    }
+    report(name + " std", num_samples, seconds_since(start), sum);
+}
+
+void benchBatched(const std::string& name, const BaseRNG& rng)
+{
+    std::vector<double> batch(batch_size);
+    auto start = TClock::now();
+    auto sum = 0.0;
+    for (size_t i = 0; i < num_samples; i += batch_size)
+    {
+        rng.generate(batch.data(), batch.size());
+        sum = std::accumulate(batch.begin(), batch.end(), sum);
+    }
+    report(name, num_samples, seconds_since(start), sum);
+}
+
+void benchSamplers()
+{
+    auto f = Factory();
+    for (double lambda : {0.01, 0.5, 5.0, 9.9, 10.0, 50.0, 1e3, 1e6})
+    {
+        auto name = "poisson lambda=" + std::to_string(lambda);
+        benchStd(name, std::poisson_distribution<int>(lambda));
+        benchBatched(name, *f.create("poisson", std::make_unique<PoissonRNGOpts>(lambda)));
+        benchBatched(name + " xoshiro", *f.create("poisson:xoshiro256ss", std::make_unique<PoissonRNGOpts>(lambda)));
+    }
+    for (double prob : {1.0, 0.9, 0.5, 0.3, 0.01, 1e-6})
+    {
+        auto name = "geometric p=" + std::to_string(prob);
+        benchStd(name, std::geometric_distribution<int>(prob));
+        benchBatched(name, *f.create("geometric", std::make_unique<GeometricRNGOpts>(prob)));
+        benchBatched(name + " xoshiro", *f.create("geometric:xoshiro256ss", std::make_unique<GeometricRNGOpts>(prob)));
+    }
+}
+
+struct Section
+{
+    const char* name;
+    void (*run)();
+};
+
+const Section sections[] = {
+    {"batch", benchBatch},
+    {"alias", benchAlias},
+    {"parallel", benchParallel},
+    {"dispatch", benchDispatch},
+    {"engines", benchEngines},
+    {"samplers", benchSamplers},
+};
+
+int main(int argc, char** argv)
+{
+    for (const auto& section : sections)
+    {
+        if (argc > 1 && std::strcmp(argv[1], section.name) != 0)
+        {
+            continue;
+        }
+        std::cout << "== " << section.name << std::endl;
+        section.run();
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// Random bit engines satisfying UniformRandomBitGenerator, all seeded from a single uint64_t.
+// Full 64-bit output lets fill_canonical build doubles from one draw.
+
+// SplitMix64, used to expand a single seed into engine state
+class SplitMix64
+{
+public:
+    using result_type = uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit SplitMix64(uint64_t seed = 0)
+        : m_state(seed)
+    {}
+
+    result_type operator()()
+    {
+        uint64_t z = (m_state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t m_state;
+};
+
+// xoshiro256** with jump(), which advances by 2^128 steps and so splits the period into non-overlapping substreams
+class Xoshiro256ss
+{
+public:
+    using result_type = uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit Xoshiro256ss(uint64_t seed = 0)
+    {
+        SplitMix64 seeder(seed);
+        for (auto& word : m_state)
+        {
+            word = seeder();
+        }
+    }
+
+    result_type operator()()
+    {
+        const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+        const uint64_t t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 45);
+        return result;
+    }
+
+    void jump()
+    {
+        static constexpr uint64_t polynomial[] = {
+            0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+        };
+        uint64_t jumped[4] = {0, 0, 0, 0};
+        for (auto word : polynomial)
+        {
+            for (int bit = 0; bit < 64; ++bit)
+            {
+                if (word & uint64_t(1) << bit)
+                {
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        jumped[i] ^= m_state[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        std::copy(jumped, jumped + 4, m_state);
+    }
+
+private:
+    uint64_t m_state[4];
+
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// PCG64 (XSL RR 128/64): 128-bit LCG with a xorshift-and-rotate output permutation
+class Pcg64
+{
+public:
+    using result_type = uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit Pcg64(uint64_t seed = 0)
+    {
+        SplitMix64 seeder(seed);
+        const unsigned __int128 initState = (unsigned __int128)seeder() << 64 | seeder();
+        const unsigned __int128 sequence = (unsigned __int128)seeder() << 64 | seeder();
+        m_increment = sequence << 1 | 1;
+        m_state = 0;
+        step();
+        m_state += initState;
+        step();
+    }
+
+    result_type operator()()
+    {
+        step();
+        const auto high = uint64_t(m_state >> 64);
+        const auto low = uint64_t(m_state);
+        const auto rotation = unsigned(m_state >> 122);
+        const uint64_t folded = high ^ low;
+        return (folded >> rotation) | (folded << ((64 - rotation) & 63));
+    }
+
+private:
+    static constexpr unsigned __int128 multiplier =
+        (unsigned __int128)0x2360ed051fc65da4 << 64 | 0x4385df649fccf645;
+
+    unsigned __int128 m_state;
+    unsigned __int128 m_increment;
+
+    void step()
+    {
+        m_state = m_state * multiplier + m_increment;
+    }
+};
+
+// Philox4x32-10: counter-based, each output block is a keyed bijection of a 128-bit counter,
+// so any position of the stream is reachable in O(1) with seek().
+class Philox4x32
+{
+public:
+    using result_type = uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    explicit Philox4x32(uint64_t seed = 0)
+        : m_key{uint32_t(seed), uint32_t(seed >> 32)}
+    {}
+
+    result_type operator()()
+    {
+        if (m_used == 2)
+        {
+            refill();
+        }
+        const uint64_t result = uint64_t(m_block[2 * m_used]) << 32 | m_block[2 * m_used + 1];
+        ++m_used;
+        return result;
+    }
+
+    // moves to output number 2 * block of the stream
+    void seek(uint64_t block)
+    {
+        m_counter[0] = uint32_t(block);
+        m_counter[1] = uint32_t(block >> 32);
+        m_counter[2] = m_counter[3] = 0;
+        m_used = 2;
+    }
+
+private:
+    uint32_t m_key[2];
+    uint32_t m_counter[4] = {0, 0, 0, 0};
+    uint32_t m_block[4] = {0, 0, 0, 0};
+    unsigned m_used = 2;
+
+    void refill()
+    {
+        uint32_t block[4] = {m_counter[0], m_counter[1], m_counter[2], m_counter[3]};
+        uint32_t key[2] = {m_key[0], m_key[1]};
+        for (int round = 0; round < 10; ++round)
+        {
+            const uint64_t product0 = uint64_t(0xd2511f53) * block[0];
+            const uint64_t product1 = uint64_t(0xcd9e8d57) * block[2];
+            const uint32_t next[4] = {
+                uint32_t(product1 >> 32) ^ block[1] ^ key[0],
+                uint32_t(product1),
+                uint32_t(product0 >> 32) ^ block[3] ^ key[1],
+                uint32_t(product0),
+            };
+            std::copy(next, next + 4, block);
+            key[0] += 0x9e3779b9;
+            key[1] += 0xbb67ae85;
+        }
+        std::copy(block, block + 4, m_block);
+        m_used = 0;
+        for (auto& word : m_counter)
+        {
+            if (++word != 0)
+            {
+                break;
+            }
+        }
+    }
+};
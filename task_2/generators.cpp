@@ -1,233 +1,135 @@
 #include <iostream>
-#include <algorithm>
-#include <random>
-#include <memory>
-#include <map>
 #include <cassert>
+#include <thread>
+
+#include "generators.h"
+#include "stats.h"
 
-constexpr double eps = 0.0000000001;
 constexpr double average_eps = 0.1;
 constexpr double num_attempts = 1000000;
 
-bool is_valid_prob(double prob)
-{
-    return prob > 0 - eps && prob < 1 + eps;
-}
-
-struct RNGOptions {
-    virtual ~RNGOptions() = default;
-
-    virtual bool valid() const = 0;
-};
-
-struct PoissonRNGOpts : public RNGOptions
-{
-    PoissonRNGOpts(double lambda)
-        : m_lambda(lambda)
-    {}
-
-    bool valid() const override
-    {
-        return m_lambda > 0;
-    }
-
-    double m_lambda;
-};
-
-struct BernoulliRNGOpts : public RNGOptions
+void testRNG(BaseRNG& rng, double expectedAverage)
 {
-    BernoulliRNGOpts(double prob)
-        : m_prob(prob)
-    {}
-
-    bool valid() const override
+    auto sum = 0.0;
+    for (int i = 0; i < num_attempts; ++i)
     {
-        return is_valid_prob(m_prob);
+        sum += rng.generate();
     }
+    std::cout << sum / num_attempts << ":" << expectedAverage << std::endl;
+    assert(std::abs(sum / num_attempts - expectedAverage) < average_eps);
+}
 
-    double m_prob;
-};
-
-struct GeometricRNGOpts : public RNGOptions
+// raw engine output: uniform mean and every bit set half of the time
+template <typename TEngine>
+void testEngine(const std::string& name)
 {
-    GeometricRNGOpts(double prob)
-        : m_prob(prob)
-    {}
-
-    bool valid() const override
+    constexpr int draws = 1000000;
+    TEngine engine(42);
+    std::vector<double> uniform(draws);
+    fill_canonical(engine, uniform.data(), uniform.size());
+    auto mean = std::accumulate(uniform.begin(), uniform.end(), 0.0) / draws;
+
+    std::vector<int> ones(64);
+    for (int i = 0; i < draws; ++i)
     {
-        return is_valid_prob(m_prob);
+        auto bits = engine();
+        for (int bit = 0; bit < 64; ++bit)
+        {
+            ones[bit] += bits >> bit & 1;
+        }
     }
+    auto minmax = std::minmax_element(ones.begin(), ones.end());
+    std::cout << name << " mean " << mean << " bit balance " << double(*minmax.first) / draws
+              << ".." << double(*minmax.second) / draws << std::endl;
+    assert(std::abs(mean - 0.5) < 0.002);
+    assert(std::abs(double(*minmax.first) / draws - 0.5) < 0.003);
+    assert(std::abs(double(*minmax.second) / draws - 0.5) < 0.003);
+}
 
-    double m_prob;
-};
-
-struct FiniteRNGOpts : public RNGOptions
+// Random123 known answer for Philox4x32-10 with key 0 and counter 0, and seek against discarding
+void testPhilox()
 {
-    FiniteRNGOpts(std::vector<double> probs, std::vector<double> values)
-        : m_values(values), m_probs(probs)
-    {}
+    Philox4x32 engine(0);
+    assert(engine() == 0x6627e8d5e169c58dULL);
+    assert(engine() == 0xbc57ac4c9b00dbd8ULL);
 
-    bool valid() const override
+    for (uint64_t block : {0ULL, 1ULL, 7ULL, 1000ULL})
     {
-        auto prob_sum = std::accumulate(m_probs.begin(), m_probs.end(), 0.0);
-        return (
-            m_values.size() == m_probs.size()
-            && std::all_of(m_probs.begin(), m_probs.end(), is_valid_prob)
-            && abs(1 - prob_sum) < eps 
-        );
+        Philox4x32 discarded(42);
+        for (uint64_t i = 0; i < 2 * block; ++i)
+        {
+            discarded();
+        }
+        Philox4x32 sought(42);
+        sought();
+        sought.seek(block);
+        for (int i = 0; i < 5; ++i)
+        {
+            assert(sought() == discarded());
+        }
     }
+    std::cout << "philox4x32 known answer and seek ok" << std::endl;
+}
 
-    std::vector<double> m_values;
-    std::vector<double> m_probs;
-};
-
-class BaseRNG
-{
-public:
-    virtual ~BaseRNG() = default;
-    virtual double generate() const = 0;
-};
-
-class PoissonRNG final : public BaseRNG
+void testBatch(BaseRNG& rng, double expectedAverage)
 {
-public:
-    using OptType = PoissonRNGOpts;
-
-    PoissonRNG(std::unique_ptr<OptType> opts)
-        : m_opts(std::move(opts)), m_generator(0), m_distribution(m_opts->m_lambda)
-    {}
-
-    double generate() const override
+    std::vector<double> batch(1000);
+    auto sum = 0.0;
+    for (int i = 0; i < num_attempts; i += batch.size())
     {
-        return m_distribution(m_generator);
+        rng.generate(batch.data(), batch.size());
+        sum = std::accumulate(batch.begin(), batch.end(), sum);
     }
+    std::cout << "batch " << sum / num_attempts << ":" << expectedAverage << std::endl;
+    assert(std::abs(sum / num_attempts - expectedAverage) < average_eps);
+}
 
-private:
-    std::unique_ptr<OptType> m_opts;
-    mutable std::poisson_distribution<int> m_distribution;
-    mutable std::default_random_engine m_generator;
-};
-
-class BernoulliRNG final : public BaseRNG
+void testParallel(Factory& f, const std::string& name, std::unique_ptr<RNGOptions>&& opts, double expectedAverage)
 {
-public:
-    using OptType = BernoulliRNGOpts;
-
-    BernoulliRNG(std::unique_ptr<OptType> opts) 
-        : m_opts(std::move(opts)), m_distribution(m_opts->m_prob)
-    {}
-
-    double generate() const override
+    constexpr size_t num_threads = 4;
+    opts->m_seed = 42;
+    auto rng = f.create(name, std::move(opts));
+    assert(rng);
+
+    // one shared RNG, a stream per thread
+    std::vector<double> sums(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
     {
-        return m_distribution(m_generator);
+        threads.emplace_back([&, t]() {
+            auto stream = rng->stream(t);
+            std::vector<double> batch(1000);
+            for (int i = 0; i < num_attempts / num_threads; i += batch.size())
+            {
+                rng->generate(stream, batch.data(), batch.size());
+                sums[t] = std::accumulate(batch.begin(), batch.end(), sums[t]);
+            }
+        });
     }
-
-private:
-    std::unique_ptr<OptType> m_opts;
-    mutable std::bernoulli_distribution m_distribution;
-    mutable std::default_random_engine m_generator;
-};
-
-class GeometricRNG final : public BaseRNG
-{
-public:
-    using OptType = GeometricRNGOpts;
-
-    GeometricRNG(std::unique_ptr<OptType>&& opts)
-        : m_opts(std::move(opts)), m_distribution(m_opts->m_prob)
-    {}
-
-    double generate() const override
+    for (auto& thread : threads)
     {
-        return m_distribution(m_generator);
+        thread.join();
     }
-
-private:
-    std::unique_ptr<OptType> m_opts;
-    mutable std::default_random_engine m_generator;
-    mutable std::geometric_distribution<int> m_distribution;
-};
-
-class FiniteRNG final : public BaseRNG
-{
-public:
-    using OptType = FiniteRNGOpts;
-
-    FiniteRNG(std::unique_ptr<OptType>&& opts)
-        : m_opts(std::move(opts)), m_distribution(m_opts->m_probs.begin(), m_opts->m_probs.end())
-    {}
-
-    double generate() const override
+    auto sum = std::accumulate(sums.begin(), sums.end(), 0.0);
+    std::cout << "parallel " << sum / num_attempts << ":" << expectedAverage << std::endl;
+    assert(std::abs(sum / num_attempts - expectedAverage) < average_eps);
+
+    // streams are reproducible from the seed and distinct from each other
+    auto first = rng->stream(1), again = rng->stream(1), other = rng->stream(2);
+    std::vector<double> a(100), b(100), c(100);
+    for (size_t i = 0; i < a.size(); ++i)
     {
-        return m_opts->m_values[m_distribution(m_generator)];
-    }
-
-private:
-    std::unique_ptr<OptType> m_opts;
-    mutable std::default_random_engine m_generator;
-    mutable std::discrete_distribution<int> m_distribution;
-};
-
-class ICreator {
-public:
-    virtual ~ICreator(){}
-    virtual std::unique_ptr<BaseRNG> create(std::unique_ptr<RNGOptions>&& opts) const = 0;
-};
-
-template <class TCurrentObject>
-class TCreator : public ICreator{
-    std::unique_ptr<BaseRNG> create(std::unique_ptr<RNGOptions>&& opts) const override {
-        auto typedOpts = dynamic_cast<typename TCurrentObject::OptType*>(opts.get());
-        opts.release();
-        if (!typedOpts || !typedOpts->valid()) return nullptr;
-        return std::make_unique<TCurrentObject>(std::unique_ptr<typename TCurrentObject::OptType>(typedOpts));
+        a[i] = rng->generate(first);
+        b[i] = rng->generate(again);
+        c[i] = rng->generate(other);
     }
-};
-
-class Factory {
-public:
-    Factory() { 
-        regAll(); 
-    }
-    
-    template <typename T>
-    void regCreator(std::string name) {
-        m_creators[name] = std::make_unique<TCreator<T>>();
-    }
-    
-    void regAll() {
-        regCreator<PoissonRNG>("poisson");
-        regCreator<BernoulliRNG>("bernoulli");
-        regCreator<GeometricRNG>("geometric");
-        regCreator<FiniteRNG>("finite");
-    }
-
-    std::unique_ptr<BaseRNG> create(const std::string& name, std::unique_ptr<RNGOptions>&& options) const {
-        auto creator = m_creators.find(name);
-        if (creator == m_creators.end()) {
-            return nullptr;
-        }
-        return creator->second->create(std::move(options));
-    }
-private:
-    std::map<std::string, std::unique_ptr<ICreator>> m_creators;
-};
-
-void testRNG(BaseRNG& rng, double expectedAverage)
-{
-    auto sum = 0.0;
-    for (int i = 0; i < num_attempts; ++i)
-    {
-        sum += rng.generate();
-    }
-    std::cout << sum / num_attempts << ":" << expectedAverage << std::endl;
-    assert(abs(sum / num_attempts - expectedAverage) < average_eps);
+    assert(a == b);
+    assert(a != c || expectedAverage == 0);
 }
 
-void testPoisson(Factory& f, double lambda)
+void testPoisson(Factory& f, double lambda, const std::string& engine = "")
 {
-    auto poi = f.create("poisson", std::make_unique<PoissonRNGOpts>(lambda));
+    auto poi = f.create("poisson" + engine, std::make_unique<PoissonRNGOpts>(lambda));
     assert(poi);
 
     auto sum = 0.0;
@@ -236,12 +138,13 @@ void testPoisson(Factory& f, double lambda)
         sum += poi->generate();
     }
     std::cout << sum / num_attempts << ":" << lambda << std::endl;
-    assert(abs(sum / num_attempts - lambda) < average_eps);
+    assert(std::abs(sum / num_attempts - lambda) < average_eps);
+    testBatch(*poi, lambda);
 }
 
-void testBernoulli(Factory& f, double prob)
+void testBernoulli(Factory& f, double prob, const std::string& engine = "")
 {
-    auto ber = f.create("bernoulli", std::make_unique<BernoulliRNGOpts>(prob));
+    auto ber = f.create("bernoulli" + engine, std::make_unique<BernoulliRNGOpts>(prob));
     assert(ber);
 
     auto sum = 0.0;
@@ -250,12 +153,13 @@ void testBernoulli(Factory& f, double prob)
         sum += ber->generate();
     }
     std::cout << sum / num_attempts << ":" << prob << std::endl;
-    assert(abs(sum / num_attempts - prob) < average_eps);
+    assert(std::abs(sum / num_attempts - prob) < average_eps);
+    testBatch(*ber, prob);
 }
 
-void testGeometric(Factory& f, double prob)
+void testGeometric(Factory& f, double prob, const std::string& engine = "")
 {
-    auto geo = f.create("geometric", std::make_unique<GeometricRNGOpts>(prob));
+    auto geo = f.create("geometric" + engine, std::make_unique<GeometricRNGOpts>(prob));
     assert(geo);
 
     auto sum = 0.0;
@@ -266,12 +170,35 @@ void testGeometric(Factory& f, double prob)
 
     auto average = (1 - prob) / prob;
     std::cout << sum / num_attempts << ":" << average << std::endl;
-    assert(abs(sum / num_attempts - average) < average_eps);
+    assert(std::abs(sum / num_attempts - average) < average_eps);
+    testBatch(*geo, average);
 }
 
-void testFinite(Factory& f, std::vector<double> probs, std::vector<double> values)
+// tiny p: draws far beyond int range, the scalar and the batch path have to agree on the mean
+void testGeometricLargeMean(Factory& f, double prob)
 {
-    auto fin = f.create("finite", std::make_unique<FiniteRNGOpts>(probs, values));
+    auto geo = f.create("geometric", std::make_unique<GeometricRNGOpts>(prob));
+    assert(geo);
+
+    auto sum = 0.0;
+    for (int i = 0; i < num_attempts; ++i)
+    {
+        sum += geo->generate();
+    }
+    std::vector<double> batch(num_attempts);
+    geo->generate(batch.data(), batch.size());
+    const auto batch_sum = std::accumulate(batch.begin(), batch.end(), 0.0);
+
+    // the standard deviation of the mean is (1 - p) / p / sqrt(n), a thousandth of the mean here
+    const auto average = (1 - prob) / prob;
+    std::cout << "large mean " << sum / num_attempts << " batch " << batch_sum / num_attempts << ":" << average << std::endl;
+    assert(std::abs(sum / num_attempts / average - 1) < 0.01);
+    assert(std::abs(batch_sum / num_attempts / average - 1) < 0.01);
+}
+
+void testFinite(Factory& f, std::vector<double> probs, std::vector<double> values, const std::string& name = "finite")
+{
+    auto fin = f.create(name, std::make_unique<FiniteRNGOpts>(probs, values));
     assert(fin);
 
     auto sum = 0.0;
@@ -286,10 +213,22 @@ void testFinite(Factory& f, std::vector<double> probs, std::vector<double> value
         average += probs[i] * values[i];
     }
     std::cout << sum / num_attempts << ":" << average << std::endl;
-    assert(abs(sum / num_attempts - average) < average_eps);
+    assert(std::abs(sum / num_attempts - average) < average_eps);
+    testBatch(*fin, average);
+}
+
+void testStats(Factory& f, const std::string& name, std::unique_ptr<RNGOptions>&& opts,
+    const DistributionTable& table, size_t samples)
+{
+    auto rng = f.create(name, std::move(opts));
+    assert(rng);
+    auto report = run_stats(*rng, table, samples, std::thread::hardware_concurrency());
+    std::cout << "stats " << name << ": " << report << std::endl;
+    assert(report.passed());
 }
 
-int main(void)
+// ./generators [harness samples per distribution]
+int main(int argc, char** argv)
 {
     auto f = Factory();
 
@@ -327,6 +266,98 @@ int main(void)
         {0, 100}
     );
 
+    // Test finite alias table
+    testFinite(
+        f,
+        {0.2, 0.3, 0.3, 0.2},
+        {0, 1, 2, 3},
+        "finite_alias"
+    );
+
+    testFinite(
+        f,
+        {0.1, 0.9},
+        {0, 100},
+        "finite_alias"
+    );
+
+    testFinite(
+        f,
+        {0.05, 0.15, 0.5, 0.3},
+        {5, -1, 2, 0.5},
+        "finite_alias"
+    );
+
+    // Test per-thread streams
+    testParallel(f, "poisson", std::make_unique<PoissonRNGOpts>(3.5), 3.5);
+    testParallel(f, "bernoulli", std::make_unique<BernoulliRNGOpts>(0.3), 0.3);
+    testParallel(f, "geometric", std::make_unique<GeometricRNGOpts>(0.25), 3);
+    testParallel(f, "finite", std::make_unique<FiniteRNGOpts>(
+        std::vector<double>{0.2, 0.3, 0.3, 0.2}, std::vector<double>{0, 1, 2, 3}), 1.5);
+    testParallel(f, "finite_alias", std::make_unique<FiniteRNGOpts>(
+        std::vector<double>{0.2, 0.3, 0.3, 0.2}, std::vector<double>{0, 1, 2, 3}), 1.5);
+
+    // Test engine backends
+    testEngine<Xoshiro256ss>("xoshiro256ss");
+    testEngine<Pcg64>("pcg64");
+    testEngine<SplitMix64>("splitmix64");
+    testEngine<Philox4x32>("philox4x32");
+    testPhilox();
+    for (const std::string engine : {":xoshiro256ss", ":pcg64", ":splitmix64", ":philox4x32"})
+    {
+        testPoisson(f, 0.5, engine);
+        testPoisson(f, 30, engine);
+        testBernoulli(f, 0.3, engine);
+        testGeometric(f, 0.3, engine);
+        testFinite(f, {0.2, 0.3, 0.3, 0.2}, {0, 1, 2, 3}, "finite" + engine);
+        testFinite(f, {0.2, 0.3, 0.3, 0.2}, {0, 1, 2, 3}, "finite_alias" + engine);
+    }
+
+    // Parallel statistics harness: moments and chi-square against the theoretical PMF (Kolmogorov-Smirnov is only reported).
+    // Streams always run on xoshiro256**, so this checks the samplers rather than the engine backends.
+    const size_t stats_samples = argc > 1 ? std::stoull(argv[1]) : 4000000;
+    testStats(f, "poisson", std::make_unique<PoissonRNGOpts>(0.5), poisson_table(0.5), stats_samples);
+    testStats(f, "poisson", std::make_unique<PoissonRNGOpts>(50), poisson_table(50), stats_samples);
+    testStats(f, "poisson", std::make_unique<PoissonRNGOpts>(0.01), poisson_table(0.01), stats_samples);
+    testStats(f, "poisson", std::make_unique<PoissonRNGOpts>(9.9), poisson_table(9.9), stats_samples);
+    testStats(f, "poisson", std::make_unique<PoissonRNGOpts>(10), poisson_table(10), stats_samples);
+    testStats(f, "poisson", std::make_unique<PoissonRNGOpts>(1e6), poisson_table(1e6), stats_samples);
+    testStats(f, "bernoulli", std::make_unique<BernoulliRNGOpts>(0.1), bernoulli_table(0.1), stats_samples);
+    testStats(f, "geometric", std::make_unique<GeometricRNGOpts>(0.3), geometric_table(0.3), stats_samples);
+    testStats(f, "geometric", std::make_unique<GeometricRNGOpts>(0.5), geometric_table(0.5), stats_samples);
+    testStats(f, "geometric", std::make_unique<GeometricRNGOpts>(0.8), geometric_table(0.8), stats_samples);
+    testStats(f, "geometric", std::make_unique<GeometricRNGOpts>(1), geometric_table(1), stats_samples);
+    testStats(f, "geometric", std::make_unique<GeometricRNGOpts>(0.001), geometric_table(0.001), stats_samples);
+    testGeometricLargeMean(f, 1e-10);
+    testStats(f, "finite", std::make_unique<FiniteRNGOpts>(
+        std::vector<double>{0.1, 0.2, 0.3, 0.4}, std::vector<double>{5, -1, 2, 0.5}),
+        finite_table({0.1, 0.2, 0.3, 0.4}, {5, -1, 2, 0.5}), stats_samples);
+    testStats(f, "finite_alias", std::make_unique<FiniteRNGOpts>(
+        std::vector<double>{0.1, 0.2, 0.3, 0.4}, std::vector<double>{5, -1, 2, 0.5}),
+        finite_table({0.1, 0.2, 0.3, 0.4}, {5, -1, 2, 0.5}), stats_samples);
+
+    // the harness must notice a slightly wrong distribution
+    auto poiWrong = f.create("poisson", std::make_unique<PoissonRNGOpts>(0.5));
+    assert(!run_stats(*poiWrong, poisson_table(0.52), stats_samples, 2).passed());
+
+    // Test static and variant dispatch
+    auto poiStatic = Factory::make<PoissonRNG>(std::make_unique<PoissonRNGOpts>(0.5));
+    assert(poiStatic);
+    testRNG(*poiStatic, 0.5);
+    assert(!Factory::make<PoissonRNG>(std::make_unique<PoissonRNGOpts>(-0.5)));
+
+    auto berVariant = f.createVariant("bernoulli", std::make_unique<BernoulliRNGOpts>(0.7));
+    assert(berVariant && std::holds_alternative<BernoulliRNG>(*berVariant));
+    auto sum = 0.0;
+    for (int i = 0; i < num_attempts; ++i)
+    {
+        sum += generate(*berVariant);
+    }
+    std::cout << "variant " << sum / num_attempts << ":" << 0.7 << std::endl;
+    assert(std::abs(sum / num_attempts - 0.7) < average_eps);
+    assert(!f.createVariant("bernoulli", std::make_unique<PoissonRNGOpts>(0.5)));
+    assert(!f.createVariant("unknown", std::make_unique<PoissonRNGOpts>(0.5)));
+
     // Test invalid
     auto poiInvalid1 = f.create("poisson", std::make_unique<BernoulliRNGOpts>(0.5));
     assert(!poiInvalid1);
@@ -334,5 +365,8 @@ int main(void)
     auto poiInvalid2 = f.create("poisson", std::make_unique<PoissonRNGOpts>(-0.5));
     assert(!poiInvalid2);
 
+    assert(!f.create("geometric", std::make_unique<GeometricRNGOpts>(0)));
+    assert(!f.create("geometric", std::make_unique<GeometricRNGOpts>(-0.5)));
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,589 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "engines.h"
+#include "samplers.h"
+
+constexpr double eps = 0.0000000001;
+
+inline bool is_valid_prob(double prob)
+{
+    return prob > 0 - eps && prob < 1 + eps;
+}
+
+struct RNGOptions {
+    virtual ~RNGOptions() = default;
+
+    virtual bool valid() const = 0;
+
+    // master seed of the per-thread streams, see BaseRNG::stream
+    uint64_t m_seed = 0;
+};
+
+struct PoissonRNGOpts : public RNGOptions
+{
+    PoissonRNGOpts(double lambda)
+        : m_lambda(lambda)
+    {}
+
+    bool valid() const override
+    {
+        return m_lambda > 0;
+    }
+
+    double m_lambda;
+};
+
+struct BernoulliRNGOpts : public RNGOptions
+{
+    BernoulliRNGOpts(double prob)
+        : m_prob(prob)
+    {}
+
+    bool valid() const override
+    {
+        return is_valid_prob(m_prob);
+    }
+
+    double m_prob;
+};
+
+struct GeometricRNGOpts : public RNGOptions
+{
+    GeometricRNGOpts(double prob)
+        : m_prob(prob)
+    {}
+
+    // p = 0 never succeeds, there is no distribution to draw from
+    bool valid() const override
+    {
+        return m_prob > 0 && is_valid_prob(m_prob);
+    }
+
+    double m_prob;
+};
+
+struct FiniteRNGOpts : public RNGOptions
+{
+    FiniteRNGOpts(std::vector<double> probs, std::vector<double> values)
+        : m_values(values), m_probs(probs)
+    {}
+
+    bool valid() const override
+    {
+        auto prob_sum = std::accumulate(m_probs.begin(), m_probs.end(), 0.0);
+        return (
+            m_values.size() == m_probs.size()
+            && std::all_of(m_probs.begin(), m_probs.end(), is_valid_prob)
+            && abs(1 - prob_sum) < eps 
+        );
+    }
+
+    std::vector<double> m_values;
+    std::vector<double> m_probs;
+};
+
+// Engine state of one thread. BaseRNG::generate(RNGStream&) keeps no other mutable state,
+// so one RNG object can be shared by any number of threads, each with its own stream.
+using RNGStream = Xoshiro256ss;
+
+// uniform doubles in [0, 1)
+template <typename TEngine>
+void fill_canonical(TEngine& engine, double* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = canonical(engine);
+    }
+}
+
+class BaseRNG
+{
+public:
+    explicit BaseRNG(uint64_t seed = 0)
+        : m_seed(seed)
+    {}
+
+    virtual ~BaseRNG() = default;
+    virtual double generate() const = 0;
+
+    // Thread-safe sampling: all mutable state lives in the caller's stream.
+    virtual double generate(RNGStream& stream) const = 0;
+
+    virtual void generate(RNGStream& stream, double* out, size_t count) const
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = generate(stream);
+        }
+    }
+
+    // Substream number index of the master seed. Substreams are 2^128 draws apart,
+    // so threads never overlap and the results depend only on the seed and the stream numbers.
+    RNGStream stream(size_t index) const
+    {
+        RNGStream stream(m_seed);
+        for (size_t i = 0; i < index; ++i)
+        {
+            stream.jump();
+        }
+        return stream;
+    }
+
+    // Fills out[0..count) paying for one virtual call per batch.
+    // Overrides draw uniforms first and transform them in a separate branch-free loop the compiler can vectorize.
+    virtual void generate(double* out, size_t count) const
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = generate();
+        }
+    }
+
+private:
+    uint64_t m_seed;
+};
+
+template <typename TEngine>
+class TPoissonRNG final : public BaseRNG
+{
+public:
+    using OptType = PoissonRNGOpts;
+
+    TPoissonRNG(std::unique_ptr<OptType> opts)
+        : BaseRNG(opts->m_seed), m_opts(std::move(opts)), m_sampler(m_opts->m_lambda), m_generator(m_opts->m_seed)
+    {}
+
+    double generate() const override
+    {
+        return m_sampler(m_generator);
+    }
+
+    void generate(double* out, size_t count) const override
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = m_sampler(m_generator);
+        }
+    }
+
+    double generate(RNGStream& stream) const override
+    {
+        return m_sampler(stream);
+    }
+
+    void generate(RNGStream& stream, double* out, size_t count) const override
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = m_sampler(stream);
+        }
+    }
+
+private:
+    std::unique_ptr<OptType> m_opts;
+    const PoissonSampler m_sampler;
+    mutable TEngine m_generator;
+};
+
+using PoissonRNG = TPoissonRNG<std::default_random_engine>;
+
+template <typename TEngine>
+class TBernoulliRNG final : public BaseRNG
+{
+public:
+    using OptType = BernoulliRNGOpts;
+
+    TBernoulliRNG(std::unique_ptr<OptType> opts) 
+        : BaseRNG(opts->m_seed), m_opts(std::move(opts)), m_distribution(m_opts->m_prob), m_generator(m_opts->m_seed)
+    {}
+
+    double generate() const override
+    {
+        return m_distribution(m_generator);
+    }
+
+    void generate(double* out, size_t count) const override
+    {
+        const double prob = m_opts->m_prob;
+        fill_canonical(m_generator, out, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = out[i] < prob ? 1.0 : 0.0;
+        }
+    }
+
+    double generate(RNGStream& stream) const override
+    {
+        double u;
+        fill_canonical(stream, &u, 1);
+        return u < m_opts->m_prob ? 1.0 : 0.0;
+    }
+
+    void generate(RNGStream& stream, double* out, size_t count) const override
+    {
+        const double prob = m_opts->m_prob;
+        fill_canonical(stream, out, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = out[i] < prob ? 1.0 : 0.0;
+        }
+    }
+
+private:
+    std::unique_ptr<OptType> m_opts;
+    mutable std::bernoulli_distribution m_distribution;
+    mutable TEngine m_generator;
+};
+
+using BernoulliRNG = TBernoulliRNG<std::default_random_engine>;
+
+template <typename TEngine>
+class TGeometricRNG final : public BaseRNG
+{
+public:
+    using OptType = GeometricRNGOpts;
+
+    TGeometricRNG(std::unique_ptr<OptType>&& opts)
+        : BaseRNG(opts->m_seed), m_opts(std::move(opts)), m_generator(m_opts->m_seed), m_sampler(m_opts->m_prob)
+    {}
+
+    double generate() const override
+    {
+        return m_sampler(m_generator);
+    }
+
+    void generate(double* out, size_t count) const override
+    {
+        generate_batch(m_generator, out, count);
+    }
+
+    double generate(RNGStream& stream) const override
+    {
+        return m_sampler(stream);
+    }
+
+    void generate(RNGStream& stream, double* out, size_t count) const override
+    {
+        generate_batch(stream, out, count);
+    }
+
+private:
+    std::unique_ptr<OptType> m_opts;
+    mutable TEngine m_generator;
+    const GeometricSampler m_sampler;
+
+    // the logarithmic inverse CDF is worth splitting into a uniform pass and a vectorizable transform pass
+    template <typename TAnyEngine>
+    void generate_batch(TAnyEngine& engine, double* out, size_t count) const
+    {
+        if (m_sampler.method() != GeometricSampler::Method::Logarithm)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                out[i] = m_sampler(engine);
+            }
+            return;
+        }
+        fill_canonical(engine, out, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = m_sampler.from_uniform(out[i]);
+        }
+    }
+};
+
+using GeometricRNG = TGeometricRNG<std::default_random_engine>;
+
+template <typename TEngine>
+class TFiniteRNG final : public BaseRNG
+{
+public:
+    using OptType = FiniteRNGOpts;
+
+    TFiniteRNG(std::unique_ptr<OptType>&& opts)
+        : BaseRNG(opts->m_seed), m_opts(std::move(opts)), m_generator(m_opts->m_seed)
+        , m_distribution(m_opts->m_probs.begin(), m_opts->m_probs.end())
+        , m_cdf(m_distribution.probabilities())
+    {
+        std::partial_sum(m_cdf.begin(), m_cdf.end(), m_cdf.begin());
+    }
+
+    double generate() const override
+    {
+        return m_opts->m_values[m_distribution(m_generator)];
+    }
+
+    void generate(double* out, size_t count) const override
+    {
+        const auto& values = m_opts->m_values;
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = values[m_distribution(m_generator)];
+        }
+    }
+
+    double generate(RNGStream& stream) const override
+    {
+        double u;
+        fill_canonical(stream, &u, 1);
+        return pick(u);
+    }
+
+    void generate(RNGStream& stream, double* out, size_t count) const override
+    {
+        fill_canonical(stream, out, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = pick(out[i]);
+        }
+    }
+
+private:
+    std::unique_ptr<OptType> m_opts;
+    mutable TEngine m_generator;
+    mutable std::discrete_distribution<int> m_distribution;
+    std::vector<double> m_cdf;
+
+    double pick(double u) const
+    {
+        auto index = std::upper_bound(m_cdf.begin(), m_cdf.end() - 1, u * m_cdf.back()) - m_cdf.begin();
+        return m_opts->m_values[index];
+    }
+};
+
+using FiniteRNG = TFiniteRNG<std::default_random_engine>;
+
+// Walker/Vose alias table: O(n) build, one uniform and one table probe per sample.
+// Column i keeps its own value with probability m_threshold[i], otherwise yields m_alias[i];
+// the columns are kept as separate arrays so sampling touches only what it reads.
+template <typename TEngine>
+class TFiniteAliasRNG final : public BaseRNG
+{
+public:
+    using OptType = FiniteRNGOpts;
+
+    TFiniteAliasRNG(std::unique_ptr<OptType>&& opts)
+        : BaseRNG(opts->m_seed), m_opts(std::move(opts)), m_generator(m_opts->m_seed)
+    {
+        build(m_opts->m_probs);
+        m_values = m_opts->m_values;
+    }
+
+    double generate() const override
+    {
+        return pick(std::generate_canonical<double, std::numeric_limits<double>::digits>(m_generator));
+    }
+
+    void generate(double* out, size_t count) const override
+    {
+        fill_canonical(m_generator, out, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = pick(out[i]);
+        }
+    }
+
+    double generate(RNGStream& stream) const override
+    {
+        double u;
+        fill_canonical(stream, &u, 1);
+        return pick(u);
+    }
+
+    void generate(RNGStream& stream, double* out, size_t count) const override
+    {
+        fill_canonical(stream, out, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = pick(out[i]);
+        }
+    }
+
+private:
+    std::unique_ptr<OptType> m_opts;
+    mutable TEngine m_generator;
+    std::vector<double> m_threshold;
+    std::vector<uint32_t> m_alias;
+    std::vector<double> m_values;
+
+    double pick(double u) const
+    {
+        const double scaled = u * m_threshold.size();
+        const auto column = static_cast<size_t>(scaled);
+        const double frac = scaled - column;
+        const auto index = frac < m_threshold[column] ? column : m_alias[column];
+        return m_values[index];
+    }
+
+    void build(const std::vector<double>& probs)
+    {
+        const size_t n = probs.size();
+        m_threshold.resize(n);
+        m_alias.resize(n);
+
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i)
+        {
+            m_threshold[i] = probs[i] * n;
+            m_alias[i] = static_cast<uint32_t>(i);
+            (m_threshold[i] < 1 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty())
+        {
+            auto less = small.back();
+            auto more = large.back();
+            small.pop_back();
+            m_alias[less] = more;
+            m_threshold[more] -= 1 - m_threshold[less];
+            if (m_threshold[more] < 1)
+            {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        // leftovers are 1 up to rounding
+        for (auto i : large)
+        {
+            m_threshold[i] = 1;
+        }
+        for (auto i : small)
+        {
+            m_threshold[i] = 1;
+        }
+    }
+};
+
+using FiniteAliasRNG = TFiniteAliasRNG<std::default_random_engine>;
+
+// Closed set of RNGs for hot loops: std::visit calls the final classes directly,
+// so the compiler can inline the sampling code instead of going through the vtable.
+using RNGVariant = std::variant<PoissonRNG, BernoulliRNG, GeometricRNG, FiniteRNG, FiniteAliasRNG>;
+
+template <typename T, typename TVariant>
+struct is_variant_alternative;
+
+template <typename T, typename... TAlternatives>
+struct is_variant_alternative<T, std::variant<TAlternatives...>>
+    : std::disjunction<std::is_same<T, TAlternatives>...>
+{};
+
+inline double generate(const RNGVariant& rng)
+{
+    return std::visit([](const auto& typed) { return typed.generate(); }, rng);
+}
+
+inline void generate(const RNGVariant& rng, double* out, size_t count)
+{
+    std::visit([out, count](const auto& typed) { typed.generate(out, count); }, rng);
+}
+
+// nullptr if options are invalid
+template <class TCurrentObject>
+std::unique_ptr<TCurrentObject> make_rng(std::unique_ptr<typename TCurrentObject::OptType>&& opts)
+{
+    if (!opts || !opts->valid()) return nullptr;
+    return std::make_unique<TCurrentObject>(std::move(opts));
+}
+
+class ICreator {
+public:
+    virtual ~ICreator(){}
+    virtual std::unique_ptr<BaseRNG> create(std::unique_ptr<RNGOptions>&& opts) const = 0;
+    virtual std::optional<RNGVariant> createVariant(std::unique_ptr<RNGOptions>&& opts) const = 0;
+};
+
+template <class TCurrentObject>
+class TCreator : public ICreator{
+    using OptType = typename TCurrentObject::OptType;
+
+    std::unique_ptr<BaseRNG> create(std::unique_ptr<RNGOptions>&& opts) const override {
+        return make_rng<TCurrentObject>(cast(std::move(opts)));
+    }
+
+    std::optional<RNGVariant> createVariant(std::unique_ptr<RNGOptions>&& opts) const override {
+        if constexpr (is_variant_alternative<TCurrentObject, RNGVariant>::value) {
+            auto typedOpts = cast(std::move(opts));
+            if (!typedOpts || !typedOpts->valid()) return std::nullopt;
+            return RNGVariant(std::in_place_type<TCurrentObject>, std::move(typedOpts));
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    // options of a wrong type stay with the caller and are freed there
+    static std::unique_ptr<OptType> cast(std::unique_ptr<RNGOptions>&& opts) {
+        auto typedOpts = dynamic_cast<OptType*>(opts.get());
+        if (!typedOpts) return nullptr;
+        opts.release();
+        return std::unique_ptr<OptType>(typedOpts);
+    }
+};
+
+class Factory {
+public:
+    Factory() { 
+        regAll(); 
+    }
+    
+    template <typename T>
+    void regCreator(std::string name) {
+        m_creators[name] = std::make_unique<TCreator<T>>();
+    }
+    
+    // "name" keeps the default engine, "name:engine" picks a backend
+    template <template <typename> class TRNG>
+    void regDistribution(const std::string& name) {
+        regCreator<TRNG<std::default_random_engine>>(name);
+        regCreator<TRNG<Xoshiro256ss>>(name + ":xoshiro256ss");
+        regCreator<TRNG<Pcg64>>(name + ":pcg64");
+        regCreator<TRNG<SplitMix64>>(name + ":splitmix64");
+        regCreator<TRNG<Philox4x32>>(name + ":philox4x32");
+    }
+
+    void regAll() {
+        regDistribution<TPoissonRNG>("poisson");
+        regDistribution<TBernoulliRNG>("bernoulli");
+        regDistribution<TGeometricRNG>("geometric");
+        regDistribution<TFiniteRNG>("finite");
+        regDistribution<TFiniteAliasRNG>("finite_alias");
+    }
+
+    std::unique_ptr<BaseRNG> create(const std::string& name, std::unique_ptr<RNGOptions>&& options) const {
+        auto creator = m_creators.find(name);
+        if (creator == m_creators.end()) {
+            return nullptr;
+        }
+        return creator->second->create(std::move(options));
+    }
+
+    // the same name lookup, but the result is dispatched with std::visit instead of virtual calls
+    std::optional<RNGVariant> createVariant(const std::string& name, std::unique_ptr<RNGOptions>&& options) const {
+        auto creator = m_creators.find(name);
+        if (creator == m_creators.end()) {
+            return std::nullopt;
+        }
+        return creator->second->createVariant(std::move(options));
+    }
+
+    // statically typed path: no lookup, no dynamic_cast and calls on the final class can be inlined
+    template <typename T>
+    static std::unique_ptr<T> make(std::unique_ptr<typename T::OptType>&& options) {
+        return make_rng<T>(std::move(options));
+    }
+private:
+    std::map<std::string, std::unique_ptr<ICreator>> m_creators;
+};
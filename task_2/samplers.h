@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "engines.h"
+
+// uniform double in [0, 1)
+template <typename TEngine>
+double canonical(TEngine& engine)
+{
+    if constexpr (TEngine::min() == 0 && TEngine::max() == std::numeric_limits<uint64_t>::max())
+    {
+        // full 64-bit engines: top 53 bits straight into the mantissa
+        return (engine() >> 11) * 0x1.0p-53;
+    }
+    else
+    {
+        return std::generate_canonical<double, std::numeric_limits<double>::digits>(engine);
+    }
+}
+
+// Poisson sampler specialized at construction: inversion over a cached CDF for small lambda,
+// where the expected search is lambda + 1 comparisons, and Hormann's PTRS transformed rejection
+// for large lambda, whose cost doesn't depend on lambda. Immutable, so it is safe to share between threads.
+class PoissonSampler
+{
+public:
+    static constexpr double ptrs_threshold = 10;
+
+    explicit PoissonSampler(double lambda)
+        : m_lambda(lambda)
+    {
+        if (lambda < ptrs_threshold)
+        {
+            // the table ends where the remaining mass is below double precision
+            double prob = std::exp(-lambda), cdf = prob;
+            m_cdf.push_back(cdf);
+            for (int k = 1; cdf < 1 - 1e-16 && k < 200; ++k)
+            {
+                prob *= lambda / k;
+                cdf += prob;
+                m_cdf.push_back(cdf);
+            }
+            return;
+        }
+        m_log_lambda = std::log(lambda);
+        m_b = 0.931 + 2.53 * std::sqrt(lambda);
+        m_a = -0.059 + 0.02483 * m_b;
+        m_log_inv_alpha = std::log(1.1239 + 1.1328 / (m_b - 3.4));
+        m_vr = 0.9277 - 3.6224 / (m_b - 2);
+    }
+
+    bool uses_rejection() const
+    {
+        return m_cdf.empty();
+    }
+
+    template <typename TEngine>
+    int operator()(TEngine& engine) const
+    {
+        return uses_rejection() ? ptrs(engine) : inversion(engine);
+    }
+
+private:
+    double m_lambda;
+    std::vector<double> m_cdf;
+    double m_log_lambda = 0;
+    double m_a = 0;
+    double m_b = 0;
+    double m_log_inv_alpha = 0;
+    double m_vr = 0;
+
+    template <typename TEngine>
+    int inversion(TEngine& engine) const
+    {
+        const double u = canonical(engine);
+        int k = 0;
+        const int last = static_cast<int>(m_cdf.size()) - 1;
+        while (k < last && u >= m_cdf[k])
+        {
+            ++k;
+        }
+        return k;
+    }
+
+    template <typename TEngine>
+    int ptrs(TEngine& engine) const
+    {
+        while (true)
+        {
+            const double u = canonical(engine) - 0.5;
+            const double v = canonical(engine);
+            const double us = 0.5 - std::abs(u);
+            const double k = std::floor((2 * m_a / us + m_b) * u + m_lambda + 0.43);
+            if (us >= 0.07 && v <= m_vr)
+            {
+                return static_cast<int>(k);
+            }
+            if (k < 0 || (us < 0.013 && v > us))
+            {
+                continue;
+            }
+            if (std::log(v) + m_log_inv_alpha - std::log(m_a / (us * us) + m_b)
+                <= -m_lambda + k * m_log_lambda - std::lgamma(k + 1))
+            {
+                return static_cast<int>(k);
+            }
+        }
+    }
+};
+
+// Geometric sampler (failures before the first success) specialized at construction:
+// p = 1 is constant, p = 1/2 counts trailing zero bits of a random word,
+// p >= 1/3 searches the CDF by multiplication in under three steps on average,
+// and smaller p uses the logarithmic inverse CDF, whose cost doesn't depend on p.
+// Draws are 64-bit and saturate at max_failures, since for tiny p they easily exceed an int.
+class GeometricSampler
+{
+public:
+    enum class Method
+    {
+        Certain,
+        Halves,
+        Search,
+        Logarithm,
+    };
+
+    // 2^62, exact as a double and convertible to int64_t
+    static constexpr double max_failures = 4611686018427387904.0;
+
+    // prob has to be in (0, 1]
+    explicit GeometricSampler(double prob)
+        : m_prob(prob)
+        , m_scale(1 / std::log1p(-prob))
+        , m_method(prob >= 1 ? Method::Certain
+            : prob == 0.5 ? Method::Halves
+            : prob >= 1.0 / 3 ? Method::Search
+            : Method::Logarithm)
+    {}
+
+    Method method() const
+    {
+        return m_method;
+    }
+
+    // floor(log(1 - u) / log(1 - p)) for u in [0, 1), vectorizable in batch loops
+    double from_uniform(double u) const
+    {
+        return std::min(std::floor(std::log1p(-u) * m_scale), max_failures);
+    }
+
+    template <typename TEngine>
+    int64_t operator()(TEngine& engine) const
+    {
+        switch (m_method)
+        {
+        case Method::Certain:
+            return 0;
+        case Method::Halves:
+            if constexpr (TEngine::min() == 0 && TEngine::max() == std::numeric_limits<uint64_t>::max())
+            {
+                int64_t failures = 0;
+                uint64_t bits;
+                while ((bits = engine()) == 0)
+                {
+                    failures += 64;
+                }
+                return failures + __builtin_ctzll(bits);
+            }
+            else
+            {
+                return search(engine);
+            }
+        case Method::Search:
+            return search(engine);
+        case Method::Logarithm:
+        default:
+            return static_cast<int64_t>(from_uniform(canonical(engine)));
+        }
+    }
+
+private:
+    double m_prob;
+    double m_scale;
+    Method m_method;
+
+    // k is the first index with u < 1 - (1 - p)^(k + 1)
+    template <typename TEngine>
+    int64_t search(TEngine& engine) const
+    {
+        const double u = canonical(engine);
+        const double q = 1 - m_prob;
+        double tail = q;
+        int64_t k = 0;
+        while (u >= 1 - tail && k < std::numeric_limits<int64_t>::max())
+        {
+            tail *= q;
+            ++k;
+        }
+        return k;
+    }
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "generators.h"
+
+// Streaming mean and variance, mergeable across threads
+struct Welford
+{
+    void add(double value)
+    {
+        ++m_count;
+        const double delta = value - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (value - m_mean);
+    }
+
+    void merge(const Welford& rhs)
+    {
+        if (rhs.m_count == 0)
+        {
+            return;
+        }
+        const double count = m_count + rhs.m_count;
+        const double delta = rhs.m_mean - m_mean;
+        m_mean += delta * rhs.m_count / count;
+        m_m2 += rhs.m_m2 + delta * delta * m_count * rhs.m_count / count;
+        m_count += rhs.m_count;
+    }
+
+    double mean() const
+    {
+        return m_mean;
+    }
+
+    double variance() const
+    {
+        return m_count > 1 ? m_m2 / (m_count - 1) : 0;
+    }
+
+    size_t m_count = 0;
+    double m_mean = 0;
+    double m_m2 = 0;
+};
+
+// Theoretical distribution over sorted outcomes. Values outside the support are counted
+// in the nearest end bucket, and tables fold the truncated tail mass into their last outcome.
+struct DistributionTable
+{
+    std::vector<double> m_values;
+    std::vector<double> m_probs;
+
+    double mean() const
+    {
+        double sum = 0;
+        for (size_t i = 0; i < m_values.size(); ++i)
+        {
+            sum += m_values[i] * m_probs[i];
+        }
+        return sum;
+    }
+
+    double variance() const
+    {
+        return central_moment(2);
+    }
+
+    double central_moment(int order) const
+    {
+        const double mu = mean();
+        double sum = 0;
+        for (size_t i = 0; i < m_values.size(); ++i)
+        {
+            sum += std::pow(m_values[i] - mu, order) * m_probs[i];
+        }
+        return sum;
+    }
+
+    size_t bucket(double value) const
+    {
+        auto it = std::lower_bound(m_values.begin(), m_values.end(), value);
+        return it == m_values.end() ? m_values.size() - 1 : it - m_values.begin();
+    }
+};
+
+inline DistributionTable poisson_table(double lambda)
+{
+    const double spread = 10 * std::sqrt(lambda) + 10;
+    const long lo = std::max(0L, long(lambda - spread));
+    const long hi = long(lambda + spread);
+    DistributionTable table;
+    for (long k = lo; k <= hi; ++k)
+    {
+        table.m_values.push_back(k);
+        table.m_probs.push_back(std::exp(k * std::log(lambda) - lambda - std::lgamma(k + 1.0)));
+    }
+    // 10 standard deviations out, the truncated mass is negligible
+    auto total = std::accumulate(table.m_probs.begin(), table.m_probs.end(), 0.0);
+    table.m_probs.back() += std::max(0.0, 1 - total);
+    return table;
+}
+
+inline DistributionTable bernoulli_table(double prob)
+{
+    return {{0, 1}, {1 - prob, prob}};
+}
+
+inline DistributionTable geometric_table(double prob)
+{
+    DistributionTable table;
+    double tail = 1;
+    for (long k = 0; tail > 1e-12 && k < 100000; ++k)
+    {
+        table.m_values.push_back(k);
+        table.m_probs.push_back(tail * prob);
+        tail *= 1 - prob;
+    }
+    table.m_probs.back() += tail;
+    return table;
+}
+
+inline DistributionTable finite_table(const std::vector<double>& probs, const std::vector<double>& values)
+{
+    std::map<double, double> merged;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        merged[values[i]] += probs[i];
+    }
+    DistributionTable table;
+    for (const auto& [value, prob] : merged)
+    {
+        table.m_values.push_back(value);
+        table.m_probs.push_back(prob);
+    }
+    return table;
+}
+
+struct StatsReport
+{
+    size_t m_samples = 0;
+    double m_seconds = 0;
+    double m_mean = 0;
+    double m_variance = 0;
+    double m_expected_mean = 0;
+    double m_expected_variance = 0;
+    // standard deviation of the sample variance, sqrt((mu4 - sigma^4) / n)
+    double m_variance_stddev = 0;
+    double m_chi2 = 0;
+    size_t m_chi2_dof = 0;
+    double m_chi2_pvalue = 1;
+    // sqrt(n) * sup |F_n - F|. Reported only: the tables are all discrete, where the continuous
+    // Kolmogorov-Smirnov critical value is conservative and would hide mismatches, so chi-square decides
+    double m_ks = 0;
+
+    // z-score of the sample mean against the expected one
+    double mean_z() const
+    {
+        return m_expected_variance > 0
+            ? (m_mean - m_expected_mean) / std::sqrt(m_expected_variance / m_samples)
+            : 0;
+    }
+
+    bool passed() const
+    {
+        return std::abs(mean_z()) < 6
+            && std::abs(m_variance - m_expected_variance) <= 6 * m_variance_stddev + eps
+            && m_chi2_pvalue > 1e-4;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StatsReport& report)
+{
+    return out << "mean " << report.m_mean << ":" << report.m_expected_mean
+               << " (z " << report.mean_z() << ")"
+               << " var " << report.m_variance << ":" << report.m_expected_variance
+               << " chi2 " << report.m_chi2 << "/" << report.m_chi2_dof << " (p " << report.m_chi2_pvalue << ")"
+               << " ks " << report.m_ks
+               << " " << report.m_samples / report.m_seconds / 1e6 << " Msamples/s";
+}
+
+// upper tail of chi-square via the Wilson-Hilferty normal approximation
+inline double chi2_pvalue(double chi2, size_t dof)
+{
+    if (dof == 0)
+    {
+        return 1;
+    }
+    const double k = dof;
+    const double z = (std::cbrt(chi2 / k) - (1 - 2 / (9 * k))) / std::sqrt(2 / (9 * k));
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// Samples rng on num_threads threads, each on its own BaseRNG::stream, and checks the result against table.
+inline StatsReport run_stats(const BaseRNG& rng, const DistributionTable& table, size_t samples, size_t num_threads)
+{
+    constexpr size_t batch = 4096;
+    num_threads = std::max<size_t>(1, num_threads);
+    std::vector<Welford> moments(num_threads);
+    std::vector<std::vector<size_t>> counts(num_threads, std::vector<size_t>(table.m_values.size()));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            auto stream = rng.stream(t);
+            std::vector<double> buffer(batch);
+            auto& local = moments[t];
+            auto& histogram = counts[t];
+            const size_t share = samples / num_threads + (t < samples % num_threads);
+            for (size_t done = 0; done < share; done += batch)
+            {
+                const size_t n = std::min(batch, share - done);
+                rng.generate(stream, buffer.data(), n);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    local.add(buffer[i]);
+                    ++histogram[table.bucket(buffer[i])];
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    StatsReport report;
+    report.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Welford total;
+    std::vector<double> histogram(table.m_values.size());
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        total.merge(moments[t]);
+        for (size_t i = 0; i < histogram.size(); ++i)
+        {
+            histogram[i] += counts[t][i];
+        }
+    }
+    report.m_samples = total.m_count;
+    report.m_mean = total.mean();
+    report.m_variance = total.variance();
+    report.m_expected_mean = table.mean();
+    report.m_expected_variance = table.variance();
+
+    report.m_variance_stddev = std::sqrt(std::max(0.0,
+        table.central_moment(4) - report.m_expected_variance * report.m_expected_variance) / report.m_samples);
+
+    // chi-square over buckets merged until each expects at least 5 hits
+    const double n = report.m_samples;
+    std::vector<double> observed{0}, expected{0};
+    double cdf = 0, ecdf = 0;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        if (expected.back() >= 5)
+        {
+            observed.push_back(0);
+            expected.push_back(0);
+        }
+        observed.back() += histogram[i];
+        expected.back() += table.m_probs[i] * n;
+
+        cdf += table.m_probs[i];
+        ecdf += histogram[i] / n;
+        report.m_ks = std::max(report.m_ks, std::abs(ecdf - cdf));
+    }
+    if (expected.size() > 1 && expected.back() < 5)
+    {
+        observed[observed.size() - 2] += observed.back();
+        expected[expected.size() - 2] += expected.back();
+        observed.pop_back();
+        expected.pop_back();
+    }
+    for (size_t i = 0; i < observed.size(); ++i)
+    {
+        report.m_chi2 += (observed[i] - expected[i]) * (observed[i] - expected[i]) / std::max(expected[i], eps);
+    }
+    report.m_chi2_dof = observed.size() - 1;
+    report.m_ks *= std::sqrt(n);
+    report.m_chi2_pvalue = chi2_pvalue(report.m_chi2, report.m_chi2_dof);
+    return report;
+}
@@ -0,0 +1,953 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "channel.h"
+#include "pipeline.h"
+#include "product_pool.h"
+#include "ring_buffer.h"
+#include "sales_log.h"
+#include "shop_engine.h"
+#include "shops.h"
+#include "thread_pool.h"
+
+// g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// ./bench [section]
+
+using TClock = std::chrono::steady_clock;
+
+// heap allocations made by the current thread, counted by the replaced global operator new
+thread_local size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// gcc can't tell that operator new above is the malloc these are paired with
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+constexpr size_t num_items = 1000000;
+constexpr size_t queue_capacity = 1024;
+
+double seconds_since(TClock::time_point start)
+{
+    return std::chrono::duration<double>(TClock::now() - start).count();
+}
+
+uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(TClock::now().time_since_epoch()).count();
+}
+
+// latencies are sorted in place
+void report(const std::string& name, size_t items, double seconds, std::vector<uint64_t>& latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))];
+    };
+    std::cout << name << ": " << items / seconds / 1e6 << " Mitems/s"
+              << ", latency ns p50 " << percentile(0.5)
+              << " p99 " << percentile(0.99)
+              << " p99.9 " << percentile(0.999)
+              << " max " << (latencies.empty() ? 0 : latencies.back()) << std::endl;
+}
+
+// the std::queue + mutex + condition_variable handoff the ring buffers replace
+class MutexQueue
+{
+public:
+    explicit MutexQueue(size_t capacity)
+        : m_capacity(capacity)
+    {}
+
+    void Push(uint64_t value)
+    {
+        std::unique_lock<std::mutex> l(m_guard);
+        m_not_full.wait(l, [&]() { return m_items.size() < m_capacity; });
+        m_items.push(value);
+        m_not_empty.notify_one();
+    }
+
+    uint64_t Pop()
+    {
+        std::unique_lock<std::mutex> l(m_guard);
+        m_not_empty.wait(l, [&]() { return !m_items.empty(); });
+        auto value = m_items.front();
+        m_items.pop();
+        m_not_full.notify_one();
+        return value;
+    }
+
+private:
+    size_t m_capacity;
+    std::mutex m_guard;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::queue<uint64_t> m_items;
+};
+
+// items carry their push timestamp, consumers record how long each one spent in the queue
+template <typename TQueue>
+void benchQueue(const std::string& name, size_t producers, size_t consumers)
+{
+    TQueue queue(queue_capacity);
+    std::vector<std::vector<uint64_t>> latencies(consumers);
+    std::vector<std::thread> threads;
+    auto start = TClock::now();
+    for (size_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&]() {
+            for (size_t i = 0; i < num_items / producers; ++i)
+            {
+                queue.Push(now_ns());
+            }
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&, c]() {
+            auto& local = latencies[c];
+            local.reserve(num_items / consumers);
+            for (size_t i = 0; i < num_items / consumers; ++i)
+            {
+                auto pushed = queue.Pop();
+                local.push_back(now_ns() - pushed);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const double seconds = seconds_since(start);
+
+    std::vector<uint64_t> merged;
+    for (auto& local : latencies)
+    {
+        merged.insert(merged.end(), local.begin(), local.end());
+    }
+    report(name + " " + std::to_string(producers) + "p" + std::to_string(consumers) + "c", merged.size(), seconds, merged);
+}
+
+void benchQueues()
+{
+    benchQueue<MutexQueue>("mutex", 1, 1);
+    benchQueue<SpscQueue<uint64_t, SpinWait>>("spsc spin", 1, 1);
+    benchQueue<SpscQueue<uint64_t, BlockWait>>("spsc block", 1, 1);
+    benchQueue<SpscQueue<uint64_t, HybridWait>>("spsc hybrid", 1, 1);
+    for (size_t threads : {1, 2, 4})
+    {
+        benchQueue<MutexQueue>("mutex", threads, threads);
+        benchQueue<MpmcQueue<uint64_t, SpinWait>>("mpmc spin", threads, threads);
+        benchQueue<MpmcQueue<uint64_t, BlockWait>>("mpmc block", threads, threads);
+        benchQueue<MpmcQueue<uint64_t, HybridWait>>("mpmc hybrid", threads, threads);
+    }
+}
+
+// small fixed-size record, the kind a log shipping stage moves around
+struct LogRecord
+{
+    uint64_t m_timestamp = 0;
+    uint32_t m_level = 0;
+    uint32_t m_length = 0;
+};
+
+constexpr size_t num_records = 10000000;
+
+void benchChannelBatch(size_t batch_size, size_t high_watermark)
+{
+    Channel<LogRecord> channel(4096, high_watermark);
+    auto start = TClock::now();
+    std::thread producer([&]() {
+        std::vector<LogRecord> batch(batch_size);
+        for (size_t i = 0; i < num_records; i += batch_size)
+        {
+            const size_t n = std::min(batch_size, num_records - i);
+            for (size_t j = 0; j < n; ++j)
+            {
+                batch[j].m_timestamp = i + j;
+            }
+            channel.PushBatch(batch.data(), n);
+        }
+        channel.Close();
+    });
+    uint64_t sum = 0;
+    size_t received = 0;
+    std::vector<LogRecord> batch(batch_size);
+    while (size_t n = channel.PopBatch(batch.data(), batch.size()))
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += batch[i].m_timestamp;
+        }
+        received += n;
+    }
+    producer.join();
+    std::cout << "channel batch " << batch_size << " high watermark " << channel.HighWatermark() << ": "
+              << received / seconds_since(start) / 1e6 << " Mrecords/s (checksum " << sum << ")" << std::endl;
+}
+
+void benchChannel()
+{
+    {
+        SpscQueue<LogRecord, BlockWait> queue(4096);
+        auto start = TClock::now();
+        std::thread producer([&]() {
+            for (size_t i = 0; i < num_records; ++i)
+            {
+                queue.Push(LogRecord{i, 0, 0});
+            }
+        });
+        uint64_t sum = 0;
+        for (size_t i = 0; i < num_records; ++i)
+        {
+            sum += queue.Pop().m_timestamp;
+        }
+        producer.join();
+        std::cout << "spsc queue single: " << num_records / seconds_since(start) / 1e6
+                  << " Mrecords/s (checksum " << sum << ")" << std::endl;
+    }
+    for (size_t batch_size : {1, 16, 256})
+    {
+        benchChannelBatch(batch_size, 0);
+    }
+    benchChannelBatch(256, 1024);
+}
+
+struct Event
+{
+    uint32_t m_user = 0;
+    uint32_t m_bytes = 0;
+    uint32_t m_region = 0;
+};
+
+void benchPipelineConfig(size_t parsers, size_t enrichers, bool ordered)
+{
+    constexpr size_t num_lines = 200000;
+    auto pipeline = Pipeline<std::string>(1024, ordered)
+        .Then("parse", parsers, [](std::string line) {
+            Event event;
+            std::sscanf(line.c_str(), "user=%u bytes=%u", &event.m_user, &event.m_bytes);
+            return event;
+        })
+        .Then("enrich", enrichers, [](Event event) {
+            // stands in for a lookup: a few rounds of mixing
+            uint64_t h = event.m_user;
+            for (int i = 0; i < 64; ++i)
+            {
+                h = (h ^ (h >> 31)) * 0x9e3779b97f4a7c15ULL;
+            }
+            event.m_region = h % 16;
+            return event;
+        });
+
+    auto start = TClock::now();
+    std::thread producer([&]() {
+        for (size_t i = 0; i < num_lines; ++i)
+        {
+            pipeline.Push("user=" + std::to_string(i % 1000) + " bytes=" + std::to_string(i % 1500));
+        }
+        pipeline.Close();
+    });
+    std::vector<uint64_t> bytes_by_region(16);
+    std::vector<StageStats> halfway;
+    Event event;
+    for (size_t popped = 0; pipeline.Pop(event); ++popped)
+    {
+        bytes_by_region[event.m_region] += event.m_bytes;
+        // queue depths in flight point at the bottleneck, after the drain they are all zero
+        if (popped == num_lines / 2)
+        {
+            halfway = pipeline.Stats();
+        }
+    }
+    producer.join();
+    const double seconds = seconds_since(start);
+
+    std::cout << "parse x" << parsers << " enrich x" << enrichers << (ordered ? " ordered" : " unordered") << ": "
+              << num_lines / seconds / 1e6 << " Mitems/s (checksum "
+              << std::accumulate(bytes_by_region.begin(), bytes_by_region.end(), uint64_t(0)) << ")" << std::endl;
+    for (const auto& stats : halfway)
+    {
+        std::cout << "    halfway " << stats << std::endl;
+    }
+    for (const auto& stats : pipeline.Stats())
+    {
+        std::cout << "    " << stats << std::endl;
+    }
+}
+
+void benchPipeline()
+{
+    for (bool ordered : {false, true})
+    {
+        benchPipelineConfig(1, 1, ordered);
+        benchPipelineConfig(2, 4, ordered);
+    }
+}
+
+constexpr size_t num_tasks = 1000000;
+
+void reportTasks(const std::string& name, size_t tasks, double seconds, uint64_t checksum)
+{
+    std::cout << name << ": " << tasks / seconds / 1e6 << " Mtasks/s, "
+              << seconds / tasks * 1e9 << " ns/task (checksum " << checksum << ")" << std::endl;
+}
+
+// a tiny task: a few multiply-xorshift rounds
+uint64_t tinyTask(uint64_t seed)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        seed = (seed ^ (seed >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    }
+    return seed;
+}
+
+void benchPool()
+{
+    ThreadPool pool;
+    {
+        std::atomic<uint64_t> sum{0};
+        auto start = TClock::now();
+        for (size_t i = 0; i < num_tasks; i += 64)
+        {
+            std::vector<std::thread> threads;
+            for (size_t j = i; j < std::min(num_tasks, i + 64); ++j)
+            {
+                threads.emplace_back([&, j]() { sum.fetch_add(tinyTask(j), std::memory_order_relaxed); });
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+        }
+        reportTasks("thread per task", num_tasks, seconds_since(start), sum.load());
+    }
+    {
+        std::vector<std::future<uint64_t>> results;
+        results.reserve(num_tasks);
+        auto start = TClock::now();
+        for (size_t i = 0; i < num_tasks; ++i)
+        {
+            results.push_back(pool.Submit([i]() { return tinyTask(i); }));
+        }
+        uint64_t sum = 0;
+        for (auto& result : results)
+        {
+            sum += result.get();
+        }
+        reportTasks("pool submit + future", num_tasks, seconds_since(start), sum);
+    }
+    {
+        std::atomic<uint64_t> sum{0};
+        auto start = TClock::now();
+        pool.ParallelFor(0, num_tasks, [&](size_t i) { sum.fetch_add(tinyTask(i), std::memory_order_relaxed); }, 1);
+        reportTasks("pool parallel_for grain 1", num_tasks, seconds_since(start), sum.load());
+    }
+    {
+        auto start = TClock::now();
+        auto sum = pool.ParallelReduce(size_t(0), num_tasks, uint64_t(0),
+            [](size_t i) { return tinyTask(i); }, std::plus<uint64_t>());
+        reportTasks("pool parallel_reduce auto grain", num_tasks, seconds_since(start), sum);
+    }
+}
+
+// product with a type chosen at runtime, so catalogues can hold many of them
+class NamedProduct : public IProductImpl
+{
+public:
+    NamedProduct(std::string type, double price)
+        : IProductImpl(price)
+        , m_type(std::move(type))
+    {}
+
+    std::string GetType() const
+    {
+        return m_type;
+    }
+
+private:
+    std::string m_type;
+};
+
+// the mutex + std::map lookup IShopImpl::Sell used to do
+class MutexShop : public IShop
+{
+public:
+    void AddProduct(IProduct& product)
+    {
+        std::unique_lock<std::mutex> m(m_prod_guard);
+        m_products[product.GetType()] = product.shared_from_this();
+    }
+
+    void DelProduct(IProduct& product)
+    {
+        std::unique_lock<std::mutex> m(m_prod_guard);
+        m_products.erase(product.GetType());
+    }
+
+    void SellAll() const
+    {}
+
+    double Sell(std::string type)
+    {
+        std::unique_lock<std::mutex> m(m_prod_guard);
+        if (m_products.find(type) != m_products.end())
+        {
+            auto sh_product = m_products[type].lock();
+            if (sh_product && sh_product->OnSale())
+            {
+                return sh_product->GetPrice();
+            }
+        }
+        return -1;
+    }
+
+private:
+    mutable std::mutex m_prod_guard;
+    std::map<std::string, std::weak_ptr<IProduct>> m_products;
+};
+
+constexpr size_t num_catalogue_products = 64;
+constexpr size_t sales_per_reader = 1000000;
+
+// readers sell round robin over the catalogue while a writer restocks one product every millisecond
+template <typename TShop>
+void benchCatalogueShop(const std::string& name, size_t num_readers)
+{
+    TShop shop;
+    std::vector<std::shared_ptr<IProduct>> products;
+    std::vector<std::string> types;
+    for (size_t i = 0; i < num_catalogue_products; ++i)
+    {
+        types.push_back("product-" + std::to_string(i));
+        products.push_back(std::make_shared<NamedProduct>(types.back(), i));
+        products.back()->StartSales();
+        products.back()->Attach(&shop);
+    }
+
+    std::atomic<bool> stop{false};
+    size_t restocks = 0;
+    std::thread writer([&]() {
+        while (!stop.load())
+        {
+            auto& product = products[restocks++ % products.size()];
+            product->Detach(&shop);
+            product->Attach(&shop);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    std::vector<double> sums(num_readers);
+    std::vector<std::thread> readers;
+    auto start = TClock::now();
+    for (size_t r = 0; r < num_readers; ++r)
+    {
+        readers.emplace_back([&, r]() {
+            double sum = 0;
+            for (size_t i = 0; i < sales_per_reader; ++i)
+            {
+                sum += shop.Sell(types[(i + r) % types.size()]);
+            }
+            sums[r] = sum;
+        });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    const double seconds = seconds_since(start);
+    stop = true;
+    writer.join();
+    std::cout << name << ", " << num_readers << " readers: "
+              << num_readers * sales_per_reader / seconds / 1e6 << " Msales/s, "
+              << restocks << " restocks (checksum " << std::accumulate(sums.begin(), sums.end(), 0.0) << ")" << std::endl;
+}
+
+struct CatalogueShop : IShopImpl
+{
+    CatalogueShop()
+        : IShopImpl(0)
+    {}
+};
+
+void benchCatalogue()
+{
+    for (size_t num_readers : {1, 2, 4, 8})
+    {
+        benchCatalogueShop<MutexShop>("mutex map", num_readers);
+        benchCatalogueShop<CatalogueShop>("rcu catalogue", num_readers);
+    }
+}
+
+// sales on one thread over names longer than the small string buffer, by std::string and by TypeId
+template <typename TShop, typename TKey>
+void benchSaleKey(const std::string& name, TShop& shop, const std::vector<TKey>& keys)
+{
+    constexpr size_t num_sales = 10000000;
+    const size_t allocations_before = allocations;
+    auto start = TClock::now();
+    double sum = 0;
+    for (size_t i = 0; i < num_sales; ++i)
+    {
+        sum += shop.Sell(keys[i % keys.size()]);
+    }
+    const double seconds = seconds_since(start);
+    std::cout << name << ": " << num_sales / seconds / 1e6 << " Msales/s, "
+              << double(allocations - allocations_before) / num_sales << " allocations/sale (checksum " << sum << ")" << std::endl;
+}
+
+void benchTypeId()
+{
+    MutexShop mutex_shop;
+    CatalogueShop shop;
+    std::vector<std::shared_ptr<IProduct>> products;
+    std::vector<std::string> names;
+    std::vector<TypeId> ids;
+    for (size_t i = 0; i < num_catalogue_products; ++i)
+    {
+        names.push_back("promotional-product-" + std::to_string(i));
+        products.push_back(std::make_shared<NamedProduct>(names.back(), i));
+        products.back()->StartSales();
+        products.back()->Attach(&mutex_shop);
+        products.back()->Attach(&shop);
+        ids.push_back(products.back()->GetTypeId());
+    }
+    benchSaleKey("mutex map, by value std::string", mutex_shop, names);
+    benchSaleKey("rcu catalogue, std::string", shop, names);
+    benchSaleKey("rcu catalogue, TypeId", shop, ids);
+}
+
+void benchPriceChurn(size_t num_churners)
+{
+    constexpr size_t num_products = 10000;
+    constexpr size_t num_shops = 1000;
+    constexpr size_t products_per_shop = 64;
+    constexpr size_t num_sellers = 2;
+    constexpr double seconds_per_run = 1.0;
+
+    std::vector<std::shared_ptr<IProduct>> products;
+    for (size_t i = 0; i < num_products; ++i)
+    {
+        products.push_back(std::make_shared<NamedProduct>("product-" + std::to_string(i), 1.0 + i % 100));
+        products.back()->StartSales();
+    }
+    std::vector<std::unique_ptr<IShopImpl>> shops;
+    std::vector<std::vector<TypeId>> listed(num_shops);
+    uint64_t random = 42;
+    auto next_random = [](uint64_t& state) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 33;
+    };
+    for (size_t s = 0; s < num_shops; ++s)
+    {
+        shops.push_back(std::make_unique<IShopImpl>(s));
+        for (size_t i = 0; i < products_per_shop; ++i)
+        {
+            auto& product = products[next_random(random) % num_products];
+            product->Attach(shops.back().get());
+            listed[s].push_back(product->GetTypeId());
+        }
+    }
+
+    std::atomic<bool> stop{false};
+    std::vector<size_t> changes(num_churners);
+    std::vector<std::thread> churners;
+    for (size_t c = 0; c < num_churners; ++c)
+    {
+        churners.emplace_back([&, c]() {
+            uint64_t state = c + 1;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                products[next_random(state) % num_products]->ChangePrice(1.0 + next_random(state) % 100);
+                ++changes[c];
+            }
+        });
+    }
+
+    // sellers run for a fixed time, churners may well take most of a core from them
+    std::vector<size_t> sales(num_sellers);
+    std::vector<double> sums(num_sellers);
+    std::vector<std::thread> sellers;
+    auto start = TClock::now();
+    for (size_t t = 0; t < num_sellers; ++t)
+    {
+        sellers.emplace_back([&, t]() {
+            uint64_t state = 1000 + t;
+            double sum = 0;
+            size_t count = 0;
+            while (seconds_since(start) < seconds_per_run)
+            {
+                for (size_t i = 0; i < 1024; ++i, ++count)
+                {
+                    const size_t shop = next_random(state) % num_shops;
+                    sum += shops[shop]->Sell(listed[shop][next_random(state) % products_per_shop]);
+                }
+            }
+            sales[t] = count;
+            sums[t] = sum;
+        });
+    }
+    for (auto& seller : sellers)
+    {
+        seller.join();
+    }
+    const double seconds = seconds_since(start);
+    stop = true;
+    for (auto& churner : churners)
+    {
+        churner.join();
+    }
+    std::cout << num_churners << " churning threads: "
+              << std::accumulate(sales.begin(), sales.end(), size_t(0)) / seconds / 1e6 << " Msales/s, "
+              << std::accumulate(changes.begin(), changes.end(), size_t(0)) / seconds / 1e6 << " Mprice changes/s"
+              << " (checksum " << std::accumulate(sums.begin(), sums.end(), 0.0) << ")" << std::endl;
+}
+
+void benchPrices()
+{
+    for (size_t num_churners : {0, 1, 2})
+    {
+        benchPriceChurn(num_churners);
+    }
+}
+
+void benchEngineShards(size_t num_shards)
+{
+    constexpr size_t num_products = 10000;
+    constexpr size_t num_shops = 1000;
+    constexpr size_t products_per_shop = 64;
+    constexpr size_t num_sales = 4000000;
+    // one price change in this many messages
+    constexpr size_t change_every = 64;
+
+    std::vector<TypeId> types;
+    for (size_t i = 0; i < num_products; ++i)
+    {
+        types.push_back(TypeRegistry::Instance().Intern("product-" + std::to_string(i)));
+    }
+    ShopEngine engine(num_shops, num_shards);
+    uint64_t random = 42;
+    auto next_random = [](uint64_t& state) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 33;
+    };
+    for (auto type : types)
+    {
+        engine.ChangePrice(type, 1.0 + next_random(random) % 100);
+        engine.StartSales(type);
+    }
+    std::vector<std::vector<TypeId>> listed(num_shops);
+    for (size_t shop = 0; shop < num_shops; ++shop)
+    {
+        for (size_t i = 0; i < products_per_shop; ++i)
+        {
+            listed[shop].push_back(types[next_random(random) % num_products]);
+            engine.Attach(shop, listed[shop].back());
+        }
+    }
+    engine.Flush();
+
+    // a client per shard, each selling in random shops of every shard
+    const size_t num_clients = num_shards;
+    std::vector<std::thread> clients;
+    auto start = TClock::now();
+    for (size_t c = 0; c < num_clients; ++c)
+    {
+        clients.emplace_back([&, c]() {
+            uint64_t state = c + 1;
+            for (size_t i = 0; i < num_sales / num_clients; ++i)
+            {
+                const size_t shop = next_random(state) % num_shops;
+                engine.Sell(shop, listed[shop][next_random(state) % products_per_shop]);
+                if (i % change_every == 0)
+                {
+                    engine.ChangePrice(types[next_random(state) % num_products], 1.0 + next_random(state) % 100);
+                }
+            }
+        });
+    }
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+    engine.Flush();
+    const double seconds = seconds_since(start);
+
+    ShopSales total;
+    for (size_t shop = 0; shop < num_shops; ++shop)
+    {
+        auto sales = engine.Sales(shop);
+        total.m_sold += sales.m_sold;
+        total.m_failed += sales.m_failed;
+        total.m_revenue += sales.m_revenue;
+    }
+    std::cout << num_shards << " shards: " << total.m_sold / seconds / 1e6 << " Msales/s"
+              << " (" << total.m_failed << " failed, revenue " << total.m_revenue << ")" << std::endl;
+}
+
+void benchEngine()
+{
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t num_shards = 1; num_shards < cores; num_shards *= 2)
+    {
+        benchEngineShards(num_shards);
+    }
+    benchEngineShards(cores);
+}
+
+// sell_basket(basket, results) sells a whole basket on every call
+template <typename TSellBasket>
+void benchBasketSeller(const std::string& name, size_t num_threads, const std::vector<TypeId>& basket, TSellBasket&& sell_basket)
+{
+    constexpr size_t items_per_thread = 20000000;
+    std::vector<double> sums(num_threads);
+    std::vector<std::thread> threads;
+    auto start = TClock::now();
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            std::vector<SaleResult> results(basket.size());
+            for (size_t i = 0; i < items_per_thread; i += basket.size())
+            {
+                sums[t] += sell_basket(basket, results);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const double seconds = seconds_since(start);
+    std::cout << name << " x" << num_threads << ": " << num_threads * items_per_thread / seconds / 1e6 << " Mitems/s"
+              << " (checksum " << std::accumulate(sums.begin(), sums.end(), 0.0) << ")" << std::endl;
+}
+
+void benchBasket()
+{
+    constexpr size_t basket_size = 256;
+    CatalogueShop shop;
+    std::vector<std::shared_ptr<IProduct>> products;
+    for (size_t i = 0; i < num_catalogue_products; ++i)
+    {
+        products.push_back(std::make_shared<NamedProduct>("basket-product-" + std::to_string(i), i));
+        // every fourth product is off sale, so baskets have failures to report
+        if (i % 4 != 0)
+        {
+            products.back()->StartSales();
+        }
+        products.back()->Attach(&shop);
+    }
+    std::vector<TypeId> basket;
+    uint64_t random = 42;
+    for (size_t i = 0; i < basket_size; ++i)
+    {
+        random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        basket.push_back(products[(random >> 33) % products.size()]->GetTypeId());
+    }
+    for (size_t num_threads : {1, 2, 4})
+    {
+        benchBasketSeller("Sell per item", num_threads, basket, [&](const std::vector<TypeId>& items, std::vector<SaleResult>&) {
+            double revenue = 0;
+            for (auto type : items)
+            {
+                const double price = shop.Sell(type);
+                revenue += price >= 0 ? price : 0;
+            }
+            return revenue;
+        });
+        benchBasketSeller("SellBatch", num_threads, basket, [&](const std::vector<TypeId>& items, std::vector<SaleResult>& results) {
+            return shop.SellBatch(items.data(), items.size(), results.data()).m_revenue;
+        });
+    }
+}
+
+// every thread appends its sales through append(record), which returns false when it drops one;
+// appenders flat out outrun any writer, so the logs drop what doesn't fit their buffers
+template <typename TAppend>
+void benchSalesSink(const std::string& name, size_t num_threads, TAppend&& append)
+{
+    constexpr size_t sales_per_thread = 200000;
+    const TypeId type = TypeRegistry::Instance().Intern("A");
+    std::vector<size_t> dropped(num_threads);
+    std::vector<std::thread> threads;
+    auto start = TClock::now();
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < sales_per_thread; ++i)
+            {
+                dropped[t] += !append({SaleRecord::Now(), int32_t(t), type, 1.0 + i % 100});
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const double seconds = seconds_since(start);
+    std::cout << name << " x" << num_threads << ": " << num_threads * sales_per_thread / seconds / 1e6 << " Mrecords/s"
+              << ", " << std::accumulate(dropped.begin(), dropped.end(), size_t(0)) << " dropped" << std::endl;
+}
+
+void benchSalesLog()
+{
+    const std::string path = "/tmp/bench_sales";
+    for (size_t num_threads : {1, 2, 4})
+    {
+        {
+            // what SellAll did before: a line per sale with endl, on a stream every shop shares
+            std::ofstream out(path + ".txt");
+            std::mutex guard;
+            benchSalesSink("mutex+endl", num_threads, [&](const SaleRecord& record) {
+                std::lock_guard<std::mutex> l(guard);
+                out << record << std::endl;
+                return true;
+            });
+        }
+        {
+            std::ofstream out(path + ".txt");
+            SalesLog log(std::make_unique<TextSalesSink>(out), 1 << 16, std::chrono::milliseconds(1));
+            benchSalesSink("log, text", num_threads, [&](const SaleRecord& record) { return log.Append(record); });
+        }
+        {
+            SalesLog log(std::make_unique<BinarySalesFile>(path + ".bin"), 1 << 16, std::chrono::milliseconds(1));
+            benchSalesSink("log, binary", num_threads, [&](const SaleRecord& record) { return log.Append(record); });
+        }
+    }
+    std::remove((path + ".txt").c_str());
+    std::remove((path + ".bin").c_str());
+}
+
+class PromoProduct : public IProductImpl
+{
+public:
+    PromoProduct(double price)
+        : IProductImpl(price)
+    {}
+
+    std::string GetType() const
+    {
+        return "promo";
+    }
+};
+
+// every thread creates products in waves and drops them again, make(price) creates one
+template <typename TMake>
+void benchProductChurn(const std::string& name, size_t num_threads, TMake&& make)
+{
+    constexpr size_t wave = 1000;
+    constexpr size_t products_per_thread = 4000000;
+    std::vector<size_t> thread_allocations(num_threads);
+    std::vector<std::thread> threads;
+    auto start = TClock::now();
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            std::vector<std::shared_ptr<IProduct>> products;
+            products.reserve(wave);
+            const size_t allocations_before = allocations;
+            for (size_t i = 0; i < products_per_thread; i += wave)
+            {
+                for (size_t j = 0; j < wave; ++j)
+                {
+                    products.push_back(make(1.0 + j));
+                }
+                products.clear();
+            }
+            thread_allocations[t] = allocations - allocations_before;
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const double seconds = seconds_since(start);
+    std::cout << name << " x" << num_threads << ": " << num_threads * products_per_thread / seconds / 1e6 << " Mproducts/s, "
+              << double(std::accumulate(thread_allocations.begin(), thread_allocations.end(), size_t(0))) / (num_threads * products_per_thread)
+              << " heap allocations/product" << std::endl;
+}
+
+void benchProducts()
+{
+    for (size_t num_threads : {1, 2, 4})
+    {
+        benchProductChurn("make_shared", num_threads, [](double price) { return std::make_shared<PromoProduct>(price); });
+        benchProductChurn("MakePooled", num_threads, [](double price) { return MakePooled<PromoProduct>(price); });
+    }
+    const auto stats = PooledStats<PromoProduct>();
+    std::cout << "pool: " << stats.m_live << " live, " << stats.m_peak << " peak, " << stats.m_allocated << " allocated, "
+              << stats.m_recycled << " recycled, " << stats.m_slabs << " slabs" << std::endl;
+}
+
+struct Section
+{
+    const char* name;
+    void (*run)();
+};
+
+const Section sections[] = {
+    {"queues", benchQueues},
+    {"channel", benchChannel},
+    {"pipeline", benchPipeline},
+    {"pool", benchPool},
+    {"catalogue", benchCatalogue},
+    {"typeid", benchTypeId},
+    {"prices", benchPrices},
+    {"engine", benchEngine},
+    {"saleslog", benchSalesLog},
+    {"basket", benchBasket},
+    {"products", benchProducts},
+};
+
+int main(int argc, char** argv)
+{
+    for (const auto& section : sections)
+    {
+        if (argc > 1 && std::strcmp(argv[1], section.name) != 0)
+        {
+            continue;
+        }
+        std::cout << "== " << section.name << std::endl;
+        section.run();
+    }
+    return 0;
+}
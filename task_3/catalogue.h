@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "type_registry.h"
+
+class IProduct;
+class PriceSlot;
+
+// Immutable snapshot of a shop's products. Entries are sorted by type for SellAll.
+// Lookups by TypeId index a flat vector; lookups by name go through an open-addressing index
+// with linear probing, which compares the cached hash first and the string only on a hash match.
+class Catalogue
+{
+public:
+    struct TEntry
+    {
+        TEntry(TypeId type_id, std::string type, std::weak_ptr<IProduct> product, std::shared_ptr<const PriceSlot> slot)
+            : m_type_id(type_id)
+            , m_type(std::move(type))
+            , m_hash(Hash(m_type))
+            , m_product(std::move(product))
+            , m_slot(std::move(slot))
+        {}
+
+        TypeId m_type_id = invalid_type_id;
+        std::string m_type;
+        uint64_t m_hash = 0;
+        std::weak_ptr<IProduct> m_product;
+        // the slot the listed product publishes into, Sell reads the sale price from it
+        std::shared_ptr<const PriceSlot> m_slot;
+    };
+
+    Catalogue() = default;
+
+    explicit Catalogue(std::vector<TEntry> entries)
+        : m_entries(std::move(entries))
+    {
+        std::sort(m_entries.begin(), m_entries.end(), [](const TEntry& lhs, const TEntry& rhs) {
+            return lhs.m_type < rhs.m_type;
+        });
+        // at most half full keeps probe sequences short
+        size_t capacity = 2;
+        while (capacity < 2 * m_entries.size())
+        {
+            capacity <<= 1;
+        }
+        m_mask = capacity - 1;
+        m_index.assign(capacity, npos);
+        for (uint32_t i = 0; i < m_entries.size(); ++i)
+        {
+            size_t slot = m_entries[i].m_hash & m_mask;
+            while (m_index[slot] != npos)
+            {
+                slot = (slot + 1) & m_mask;
+            }
+            m_index[slot] = i;
+            if (m_entries[i].m_type_id >= m_by_id.size())
+            {
+                m_by_id.resize(m_entries[i].m_type_id + 1, npos);
+            }
+            m_by_id[m_entries[i].m_type_id] = i;
+        }
+    }
+
+    static uint64_t Hash(const std::string& type)
+    {
+        return std::hash<std::string>()(type);
+    }
+
+    const TEntry* Find(TypeId type) const
+    {
+        return type < m_by_id.size() && m_by_id[type] != npos ? &m_entries[m_by_id[type]] : nullptr;
+    }
+
+    const TEntry* Find(const std::string& type) const
+    {
+        return Find(type, Hash(type));
+    }
+
+    const TEntry* Find(const std::string& type, uint64_t hash) const
+    {
+        if (m_entries.empty())
+        {
+            return nullptr;
+        }
+        for (size_t slot = hash & m_mask; m_index[slot] != npos; slot = (slot + 1) & m_mask)
+        {
+            const TEntry& entry = m_entries[m_index[slot]];
+            if (entry.m_hash == hash && entry.m_type == type)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    const std::vector<TEntry>& Entries() const
+    {
+        return m_entries;
+    }
+
+    // copy with the product of that type added or replaced
+    Catalogue With(TypeId type, std::weak_ptr<IProduct> product, std::shared_ptr<const PriceSlot> slot) const
+    {
+        auto entries = m_entries;
+        TEntry entry(type, TypeRegistry::Instance().Name(type), std::move(product), std::move(slot));
+        if (auto found = Find(type))
+        {
+            entries[found - m_entries.data()] = std::move(entry);
+        }
+        else
+        {
+            entries.push_back(std::move(entry));
+        }
+        return Catalogue(std::move(entries));
+    }
+
+    // copy without the product of that type
+    Catalogue Without(TypeId type) const
+    {
+        auto entries = m_entries;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const TEntry& entry) {
+            return entry.m_type_id == type;
+        }), entries.end());
+        return Catalogue(std::move(entries));
+    }
+
+private:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    std::vector<TEntry> m_entries;
+    std::vector<uint32_t> m_index;
+    size_t m_mask = 0;
+    // entry index by TypeId, as long as the largest id in the catalogue
+    std::vector<uint32_t> m_by_id;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "ring_buffer.h"
+
+// Single-producer single-consumer channel that moves items in batches.
+// The producer is held back once high_watermark items are queued and resumes when the consumer
+// drains the channel to low_watermark. Sleepers are woken only on the transitions that matter:
+// the consumer when the channel goes from empty to non-empty, the producer when it drops to the low watermark.
+// Items have to be default constructible and move assignable.
+template <typename T, typename TWait = BlockWait>
+class Channel
+{
+public:
+    // capacity is rounded up to a power of two, watermarks default to the full capacity and half of it
+    explicit Channel(size_t capacity, size_t high_watermark = 0, size_t low_watermark = 0)
+        : m_mask(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1)
+        , m_high(high_watermark == 0 ? m_mask + 1 : std::min(high_watermark, m_mask + 1))
+        , m_low(low_watermark == 0 ? m_high / 2 : std::min(low_watermark, m_high - 1))
+        , m_items(new T[m_mask + 1])
+    {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    size_t HighWatermark() const
+    {
+        return m_high;
+    }
+
+    size_t LowWatermark() const
+    {
+        return m_low;
+    }
+
+    // after Close pushes fail, pops drain what is left and then return nothing
+    void Close()
+    {
+        m_closed.store(true, std::memory_order_seq_cst);
+        m_not_empty.Notify();
+        m_not_full.Notify();
+    }
+
+    bool Closed() const
+    {
+        return m_closed.load(std::memory_order_acquire);
+    }
+
+    // producer side: moves as many items as fit under the high watermark, returns how many
+    size_t TryPushBatch(T* items, size_t count)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head + count > m_high)
+        {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+        }
+        const size_t size = tail - m_cached_head;
+        const size_t n = std::min(count, size < m_high ? m_high - size : 0);
+        if (n == 0)
+        {
+            return 0;
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            m_items[(tail + i) & m_mask] = std::move(items[i]);
+        }
+        m_tail.store(tail + n, std::memory_order_seq_cst);
+        // the consumer can only be asleep if it had taken everything before this batch
+        if constexpr (TWait::notifies)
+        {
+            if (m_head.load(std::memory_order_seq_cst) == tail)
+            {
+                m_not_empty.Notify();
+            }
+        }
+        return n;
+    }
+
+    // producer side: blocks until every item is queued, false if the channel got closed first
+    bool PushBatch(T* items, size_t count)
+    {
+        size_t done = 0;
+        while (done < count)
+        {
+            if (Closed())
+            {
+                return false;
+            }
+            const size_t n = TryPushBatch(items + done, count - done);
+            if (n == 0)
+            {
+                TWait::Wait(m_not_full, [&]() {
+                    return Closed() || m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_seq_cst) <= m_low;
+                });
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    bool Push(T value)
+    {
+        return PushBatch(&value, 1);
+    }
+
+    // consumer side: moves up to max_count items into out, returns how many
+    size_t TryPopBatch(T* out, size_t max_count)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_cached_tail - head < max_count)
+        {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+        }
+        const size_t n = std::min(max_count, m_cached_tail - head);
+        if (n == 0)
+        {
+            return 0;
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = std::move(m_items[(head + i) & m_mask]);
+        }
+        m_head.store(head + n, std::memory_order_seq_cst);
+        // the producer can only be asleep if it saw the high watermark, wake it once we cross the low one
+        if constexpr (TWait::notifies)
+        {
+            const size_t before = m_tail.load(std::memory_order_seq_cst) - head;
+            if (before > m_low && before - n <= m_low)
+            {
+                m_not_full.Notify();
+            }
+        }
+        return n;
+    }
+
+    // consumer side: blocks until there is at least one item, 0 means the channel is closed and drained
+    size_t PopBatch(T* out, size_t max_count)
+    {
+        while (true)
+        {
+            if (const size_t n = TryPopBatch(out, max_count))
+            {
+                return n;
+            }
+            if (Closed())
+            {
+                // items pushed right before Close
+                return TryPopBatch(out, max_count);
+            }
+            TWait::Wait(m_not_empty, [&]() {
+                return Closed() || m_tail.load(std::memory_order_seq_cst) != m_head.load(std::memory_order_relaxed);
+            });
+        }
+    }
+
+    bool Pop(T& out)
+    {
+        return PopBatch(&out, 1) == 1;
+    }
+
+private:
+    const size_t m_mask;
+    const size_t m_high;
+    const size_t m_low;
+    const std::unique_ptr<T[]> m_items;
+
+    // consumer side
+    alignas(cache_line) std::atomic<size_t> m_head{0};
+    size_t m_cached_tail = 0;
+    // producer side
+    alignas(cache_line) std::atomic<size_t> m_tail{0};
+    size_t m_cached_head = 0;
+
+    alignas(cache_line) std::atomic<bool> m_closed{false};
+    WaitEvent m_not_empty;
+    WaitEvent m_not_full;
+};
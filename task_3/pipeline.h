@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ring_buffer.h"
+
+struct StageStats
+{
+    std::string m_name;
+    size_t m_workers = 0;
+    uint64_t m_items = 0;
+    // time spent inside the stage callable, summed over workers
+    double m_busy_seconds = 0;
+    // items waiting in the stage's input queue when the stats were taken
+    size_t m_queue_depth = 0;
+    size_t m_queue_capacity = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StageStats& stats)
+{
+    return out << stats.m_name << " x" << stats.m_workers
+               << ": " << stats.m_items << " items"
+               << ", busy " << stats.m_busy_seconds << " s"
+               << ", queue " << stats.m_queue_depth << "/" << stats.m_queue_capacity;
+}
+
+// items carry their input sequence number, so ordered pipelines can restore the input order at the end
+template <typename T>
+using TSequenced = std::pair<uint64_t, T>;
+
+template <typename T>
+using TStageQueue = MpmcQueue<TSequenced<T>, HybridWait>;
+
+// sequence numbers and closing state of a pipeline, shared by pushing and popping threads and handed on by Then
+struct PipelineSequence
+{
+    // Push calls past their closed check; the input queue is closed by whichever of Close
+    // and the last of them comes last, so every item those calls push is drained
+    std::atomic<size_t> m_pushers{0};
+    std::atomic<bool> m_closing{false};
+    std::atomic<uint64_t> m_next_in{0};
+    // the next sequence number an ordered Pop hands out
+    std::atomic<uint64_t> m_next_out{0};
+    WaitEvent m_window_open;
+};
+
+class IPipelineStage
+{
+public:
+    virtual ~IPipelineStage() = default;
+
+    virtual StageStats Stats() const = 0;
+};
+
+// Worker threads that map items from one queue into the next. The last worker to see
+// the input closed and drained closes the output, so shutdown flows down the pipeline.
+template <typename TIn, typename TOut, typename TFunc>
+class PipelineStage : public IPipelineStage
+{
+public:
+    PipelineStage(std::string name, size_t workers, TFunc func,
+        std::shared_ptr<TStageQueue<TIn>> input, std::shared_ptr<TStageQueue<TOut>> output)
+        : m_name(std::move(name))
+        , m_func(std::move(func))
+        , m_input(std::move(input))
+        , m_output(std::move(output))
+        , m_counters(std::max<size_t>(1, workers))
+        , m_running(m_counters.size())
+    {
+        for (size_t i = 0; i < m_counters.size(); ++i)
+        {
+            m_workers.emplace_back([this, i]() { Work(m_counters[i]); });
+        }
+    }
+
+    ~PipelineStage()
+    {
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    StageStats Stats() const
+    {
+        StageStats stats;
+        stats.m_name = m_name;
+        stats.m_workers = m_workers.size();
+        for (const auto& counters : m_counters)
+        {
+            stats.m_items += counters.m_items.load(std::memory_order_relaxed);
+            stats.m_busy_seconds += counters.m_busy_ns.load(std::memory_order_relaxed) * 1e-9;
+        }
+        stats.m_queue_depth = m_input->Size();
+        stats.m_queue_capacity = m_input->Capacity();
+        return stats;
+    }
+
+private:
+    // per worker, so counting doesn't bounce a shared line between them
+    struct alignas(cache_line) TCounters
+    {
+        std::atomic<uint64_t> m_items{0};
+        std::atomic<uint64_t> m_busy_ns{0};
+    };
+
+    const std::string m_name;
+    const TFunc m_func;
+    const std::shared_ptr<TStageQueue<TIn>> m_input;
+    const std::shared_ptr<TStageQueue<TOut>> m_output;
+    std::vector<TCounters> m_counters;
+    std::atomic<size_t> m_running;
+    std::vector<std::thread> m_workers;
+
+    void Work(TCounters& counters)
+    {
+        TSequenced<TIn> item;
+        while (m_input->Pop(item))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            TSequenced<TOut> result(item.first, m_func(std::move(item.second)));
+            const auto busy = std::chrono::steady_clock::now() - start;
+            counters.m_busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(),
+                std::memory_order_relaxed);
+            counters.m_items.fetch_add(1, std::memory_order_relaxed);
+            m_output->Push(std::move(result));
+        }
+        if (m_running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            m_output->Close();
+        }
+    }
+};
+
+// Chain of stages linked by bounded queues, built with Then:
+//
+//     auto pipeline = Pipeline<std::string>(1024)
+//         .Then("parse", 2, parse)
+//         .Then("enrich", 4, enrich);
+//     pipeline.Push(line); ... pipeline.Close();
+//     while (pipeline.Pop(record)) ...
+//
+// Each stage maps every item to exactly one output and runs its callable on several workers at once,
+// so the callable must be thread-safe. Close drains: everything pushed before it still comes out of Pop.
+// An ordered pipeline hands items out in input order and then Pop must be called from one thread at a time.
+// Push then also blocks while its item would be more than 4 * capacity ahead of the next item Pop hands out,
+// which bounds the reorder buffer when one slow item holds up everything behind it.
+template <typename TIn, typename TOut = TIn>
+class Pipeline
+{
+public:
+    explicit Pipeline(size_t capacity, bool ordered = false)
+        : m_capacity(capacity)
+        , m_ordered(ordered)
+        , m_sequence(std::make_unique<PipelineSequence>())
+        , m_input(std::make_shared<TStageQueue<TIn>>(capacity))
+        , m_output(m_input)
+    {
+        static_assert(std::is_same_v<TIn, TOut>, "stages are added with Then");
+    }
+
+    Pipeline(Pipeline&&) = default;
+
+    ~Pipeline()
+    {
+        if (!m_input)
+        {
+            return;
+        }
+        // unread output would keep the workers blocked on full queues
+        Close();
+        TSequenced<TOut> item;
+        while (m_output->Pop(item))
+        {}
+        m_stages.clear();
+    }
+
+    // appends a stage running func on workers threads, items already pushed flow into it
+    template <typename TFunc>
+    auto Then(std::string name, size_t workers, TFunc func) &&
+    {
+        using TNext = std::decay_t<std::invoke_result_t<const TFunc&, TOut&&>>;
+        auto output = std::make_shared<TStageQueue<TNext>>(m_capacity);
+        m_stages.push_back(std::make_unique<PipelineStage<TOut, TNext, TFunc>>(
+            std::move(name), workers, std::move(func), m_output, output));
+
+        Pipeline<TIn, TNext> next(std::move(*this), output);
+        return next;
+    }
+
+    // false once the pipeline is closed; a push racing Close either fails or its item comes out of Pop
+    bool Push(TIn item)
+    {
+        // seq_cst against Close: either this sees the pipeline closing or Close sees this push in flight
+        m_sequence->m_pushers.fetch_add(1, std::memory_order_seq_cst);
+        const bool pushed = !m_sequence->m_closing.load(std::memory_order_seq_cst) && PushOpen(std::move(item));
+        if (m_sequence->m_pushers.fetch_sub(1, std::memory_order_seq_cst) == 1
+            && m_sequence->m_closing.load(std::memory_order_seq_cst))
+        {
+            m_input->Close();
+        }
+        return pushed;
+    }
+
+    // no more input, the stages finish what they have and shut down one after another
+    void Close()
+    {
+        m_sequence->m_closing.store(true, std::memory_order_seq_cst);
+        // pushes waiting for the window give up
+        m_sequence->m_window_open.Notify();
+        if (m_sequence->m_pushers.load(std::memory_order_seq_cst) == 0)
+        {
+            m_input->Close();
+        }
+    }
+
+    // blocks until there is an output item, false once the pipeline is closed and drained
+    bool Pop(TOut& out)
+    {
+        TSequenced<TOut> item;
+        if (!m_ordered)
+        {
+            if (!m_output->Pop(item))
+            {
+                return false;
+            }
+            out = std::move(item.second);
+            return true;
+        }
+        while (m_reorder.empty() || m_reorder.begin()->first != m_next_out)
+        {
+            if (!m_output->Pop(item))
+            {
+                return false;
+            }
+            m_reorder.emplace(item.first, std::move(item.second));
+        }
+        out = std::move(m_reorder.begin()->second);
+        m_reorder.erase(m_reorder.begin());
+        m_sequence->m_next_out.store(++m_next_out, std::memory_order_release);
+        m_sequence->m_window_open.Notify();
+        return true;
+    }
+
+    std::vector<StageStats> Stats() const
+    {
+        std::vector<StageStats> stats;
+        for (const auto& stage : m_stages)
+        {
+            stats.push_back(stage->Stats());
+        }
+        return stats;
+    }
+
+private:
+    template <typename, typename>
+    friend class Pipeline;
+
+    size_t m_capacity;
+    bool m_ordered;
+    std::unique_ptr<PipelineSequence> m_sequence;
+    std::shared_ptr<TStageQueue<TIn>> m_input;
+    std::shared_ptr<TStageQueue<TOut>> m_output;
+    std::vector<std::unique_ptr<IPipelineStage>> m_stages;
+    // out of order items of an ordered pipeline, fewer than the push window
+    std::map<uint64_t, TOut> m_reorder;
+    uint64_t m_next_out = 0;
+
+    template <typename TPrev>
+    Pipeline(Pipeline<TIn, TPrev>&& prev, std::shared_ptr<TStageQueue<TOut>> output)
+        : m_capacity(prev.m_capacity)
+        , m_ordered(prev.m_ordered)
+        , m_sequence(std::move(prev.m_sequence))
+        , m_input(std::move(prev.m_input))
+        , m_output(std::move(output))
+        , m_stages(std::move(prev.m_stages))
+    {}
+
+    // past the closed check of Push
+    bool PushOpen(TIn&& item)
+    {
+        const uint64_t sequence = m_sequence->m_next_in.fetch_add(1, std::memory_order_relaxed);
+        if (m_ordered)
+        {
+            const uint64_t window = 4 * m_capacity;
+            auto open = [&]() { return sequence < m_sequence->m_next_out.load(std::memory_order_acquire) + window; };
+            HybridWait::Wait(m_sequence->m_window_open, [&]() {
+                return open() || m_sequence->m_closing.load(std::memory_order_seq_cst);
+            });
+            if (!open())
+            {
+                return false;
+            }
+        }
+        m_input->Push({sequence, std::move(item)});
+        return true;
+    }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "type_registry.h"
+
+// Sale state one product publishes into one inbox. The product overwrites it on every change and
+// the shop's catalogue entry points at it, so sales read the latest state with nothing left to apply.
+// Shared by the two, it goes away with whichever of them lets go last.
+class PriceSlot
+{
+public:
+    explicit PriceSlot(TypeId type)
+        : m_type(type)
+    {}
+
+    PriceSlot(const PriceSlot&) = delete;
+    PriceSlot& operator=(const PriceSlot&) = delete;
+
+    TypeId Type() const
+    {
+        return m_type;
+    }
+
+    // the price while the product is on sale, -1 otherwise
+    double SalePrice() const
+    {
+        return m_sale_price.load(std::memory_order_acquire);
+    }
+
+private:
+    friend class PriceInbox;
+
+    const TypeId m_type;
+    std::atomic<double> m_sale_price{-1};
+};
+
+// Where products publish their price changes for a single shop: one slot per subscription, written
+// with a single store, so neither the products nor the shop's sales take a lock for it.
+// Shops own their inbox through a shared_ptr shared with their products, so a product
+// publishing into the inbox of a shop that is gone is harmless; it drops closed inboxes.
+class PriceInbox
+{
+public:
+    PriceInbox() = default;
+
+    PriceInbox(const PriceInbox&) = delete;
+    PriceInbox& operator=(const PriceInbox&) = delete;
+
+    std::shared_ptr<PriceSlot> Open(TypeId type)
+    {
+        return std::make_shared<PriceSlot>(type);
+    }
+
+    // calls for one slot have to be serialized by the publisher
+    void Publish(PriceSlot& slot, double sale_price)
+    {
+        slot.m_sale_price.store(sale_price, std::memory_order_release);
+    }
+
+    void Close()
+    {
+        m_closed.store(true, std::memory_order_release);
+    }
+
+    bool Closed() const
+    {
+        return m_closed.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<bool> m_closed{false};
+};
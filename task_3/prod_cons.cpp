@@ -1,47 +1,43 @@
 #include <iostream>
 #include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <vector>
 #include <cassert>
 
+#include "channel.h"
+
 int main() {
-    std::mutex m;
-    std::condition_variable cvar;
-    size_t count = 0;
-    bool done = false;
-    bool notified = false;
-    std::queue<int> items;
-    
+    constexpr size_t num_items = 10000;
+    constexpr size_t batch_size = 64;
+    Channel<int> items(1024);
+    size_t pushed = 0;
+    size_t popped = 0;
+
     std::thread producer([&]() {
-        for (int i = 0; i < 10000; ++i) {
-            std::unique_lock<std::mutex> l(m);
-            if (i != 0) { 
-                while (!notified) {
-                    cvar.wait(l);
-                }
-                notified = false;
+        std::vector<int> batch;
+        for (size_t i = 0; i < num_items; ++i) {
+            batch.push_back(static_cast<int>(i));
+            if (batch.size() == batch_size || i + 1 == num_items) {
+                items.PushBatch(batch.data(), batch.size());
+                pushed += batch.size();
+                batch.clear();
             }
-            items.push(i);
-            count++;
         }
-        done = true;
+        items.Close();
     });
 
+    // PopBatch returns 0 only once the channel is closed and drained
     std::thread consumer([&]() {
-        while (!done) {
-            while (!items.empty()) {
-                items.pop();
-                std::unique_lock<std::mutex> l(m);
-                notified = true;
-                cvar.notify_one();
-                count--;
+        std::vector<int> batch(batch_size);
+        while (size_t n = items.PopBatch(batch.data(), batch.size())) {
+            for (size_t i = 0; i < n; ++i) {
+                assert(batch[i] == static_cast<int>(popped + i));
             }
+            popped += n;
         }
     });
-    
+
     producer.join();
     consumer.join();
-    
-    std::cout << count << std::endl;
+
+    std::cout << pushed - popped << std::endl;
 }
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+struct PoolStats
+{
+    // blocks handed out and not freed yet
+    uint64_t m_live = 0;
+    // most blocks ever outside the shared free list, i.e. live or waiting in a thread cache;
+    // an upper bound of the peak of live that is off by a few thread caches at most
+    uint64_t m_peak = 0;
+    uint64_t m_allocated = 0;
+    // allocations served by a block that had been freed before
+    uint64_t m_recycled = 0;
+    uint64_t m_slabs = 0;
+};
+
+// Fixed-size blocks carved out of slabs that are never returned to the heap. Every thread allocates
+// from and frees into a cache of its own, with no lock and no atomic read-modify-write; only
+// refilling an empty cache or returning half of an overfull one takes the pool's mutex, a batch at a time.
+// A block freed on another thread than it was allocated on simply joins that thread's cache.
+class SlabPool
+{
+    // what a block holds while it is free
+    struct TFreeBlock
+    {
+        TFreeBlock* m_next;
+    };
+
+public:
+    class TCache;
+
+    SlabPool(size_t block_size, size_t block_align, size_t blocks_per_slab = 256, size_t batch = 64)
+        : m_block_align(std::max(block_align, alignof(TFreeBlock)))
+        , m_block_size((std::max(block_size, sizeof(TFreeBlock)) + m_block_align - 1) / m_block_align * m_block_align)
+        , m_blocks_per_slab(std::max<size_t>(blocks_per_slab, 1))
+        , m_batch(std::max<size_t>(batch, 1))
+    {}
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    ~SlabPool()
+    {
+        for (void* slab : m_slabs)
+        {
+            if (m_block_align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            {
+                ::operator delete(slab, std::align_val_t(m_block_align));
+            }
+            else
+            {
+                ::operator delete(slab);
+            }
+        }
+    }
+
+    size_t BlockSize() const
+    {
+        return m_block_size;
+    }
+
+    // For a thread whose cache is gone already, e.g. one freeing products from its thread_local
+    // destructors: one block at a time from and to the shared free list, under the lock.
+    void* AllocateLocked()
+    {
+        std::lock_guard<std::mutex> l(m_guard);
+        ++m_retired.m_allocated;
+        if (m_free)
+        {
+            ++m_retired.m_recycled;
+        }
+        else
+        {
+            // a slab carved up front: there is no cache to hand its untouched tail to
+            char* slab = NewSlab();
+            for (size_t i = m_blocks_per_slab; i-- > 0;)
+            {
+                m_free = new (slab + i * m_block_size) TFreeBlock{m_free};
+            }
+        }
+        TFreeBlock* block = m_free;
+        m_free = block->m_next;
+        Take(1);
+        return block;
+    }
+
+    void DeallocateLocked(void* block)
+    {
+        std::lock_guard<std::mutex> l(m_guard);
+        ++m_retired_freed;
+        m_free = new (block) TFreeBlock{m_free};
+        --m_outstanding;
+    }
+
+    PoolStats Stats() const
+    {
+        std::lock_guard<std::mutex> l(m_guard);
+        PoolStats stats = m_retired;
+        uint64_t freed = m_retired_freed;
+        for (const TCache* cache : m_caches)
+        {
+            stats.m_allocated += cache->m_allocated.load(std::memory_order_relaxed);
+            stats.m_recycled += cache->m_recycled.load(std::memory_order_relaxed);
+            freed += cache->m_freed.load(std::memory_order_relaxed);
+        }
+        // the counters of running threads are read one after another, so a free may be seen
+        // without the allocation it pairs with
+        stats.m_live = stats.m_allocated > freed ? stats.m_allocated - freed : 0;
+        stats.m_peak = m_peak_outstanding;
+        stats.m_slabs = m_slabs.size();
+        return stats;
+    }
+
+    // a thread's view of one pool, gives everything back to the pool when the thread exits
+    class TCache
+    {
+    public:
+        explicit TCache(SlabPool& pool)
+            : m_pool(pool)
+        {
+            std::lock_guard<std::mutex> l(m_pool.m_guard);
+            m_pool.m_caches.push_back(this);
+        }
+
+        TCache(const TCache&) = delete;
+        TCache& operator=(const TCache&) = delete;
+
+        ~TCache()
+        {
+            // unused fresh blocks go back as free ones, so this thread's counters don't change
+            while (m_fresh != m_fresh_end)
+            {
+                Push(m_fresh);
+                m_fresh += m_pool.m_block_size;
+            }
+            std::lock_guard<std::mutex> l(m_pool.m_guard);
+            m_pool.Return(*this, m_free_count);
+            m_pool.m_retired.m_allocated += m_allocated.load(std::memory_order_relaxed);
+            m_pool.m_retired.m_recycled += m_recycled.load(std::memory_order_relaxed);
+            m_pool.m_retired_freed += m_freed.load(std::memory_order_relaxed);
+            m_pool.m_caches.erase(std::find(m_pool.m_caches.begin(), m_pool.m_caches.end(), this));
+        }
+
+        void* Allocate()
+        {
+            if (!m_free && m_fresh == m_fresh_end)
+            {
+                m_pool.Refill(*this);
+            }
+            Bump(m_allocated);
+            if (m_free)
+            {
+                Bump(m_recycled);
+                return Pop();
+            }
+            void* block = m_fresh;
+            m_fresh += m_pool.m_block_size;
+            return block;
+        }
+
+        void Deallocate(void* block)
+        {
+            Bump(m_freed);
+            Push(static_cast<char*>(block));
+            if (m_free_count > 2 * m_pool.m_batch)
+            {
+                std::lock_guard<std::mutex> l(m_pool.m_guard);
+                m_pool.Return(*this, m_pool.m_batch);
+            }
+        }
+
+    private:
+        friend class SlabPool;
+
+        SlabPool& m_pool;
+        TFreeBlock* m_free = nullptr;
+        size_t m_free_count = 0;
+        // never allocated blocks of the current slab
+        char* m_fresh = nullptr;
+        char* m_fresh_end = nullptr;
+        // written by the owner only, atomic just so Stats can read them
+        std::atomic<uint64_t> m_allocated{0};
+        std::atomic<uint64_t> m_recycled{0};
+        std::atomic<uint64_t> m_freed{0};
+
+        static void Bump(std::atomic<uint64_t>& counter)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        void Push(char* block)
+        {
+            m_free = new (block) TFreeBlock{m_free};
+            ++m_free_count;
+        }
+
+        void* Pop()
+        {
+            TFreeBlock* block = m_free;
+            m_free = block->m_next;
+            --m_free_count;
+            return block;
+        }
+    };
+
+private:
+    const size_t m_block_align;
+    const size_t m_block_size;
+    const size_t m_blocks_per_slab;
+    const size_t m_batch;
+
+    mutable std::mutex m_guard;
+    TFreeBlock* m_free = nullptr;
+    std::vector<void*> m_slabs;
+    std::vector<const TCache*> m_caches;
+    // counters of the caches of threads that exited and of the locked calls
+    PoolStats m_retired;
+    uint64_t m_retired_freed = 0;
+    // blocks outside m_free and the slabs' untouched tails
+    uint64_t m_outstanding = 0;
+    uint64_t m_peak_outstanding = 0;
+
+    // the cache is out of blocks: a batch of free ones if there are any, else a new slab to carve
+    void Refill(TCache& cache)
+    {
+        std::lock_guard<std::mutex> l(m_guard);
+        size_t taken = 0;
+        while (m_free && taken < m_batch)
+        {
+            TFreeBlock* block = m_free;
+            m_free = block->m_next;
+            cache.Push(reinterpret_cast<char*>(block));
+            ++taken;
+        }
+        if (taken == 0)
+        {
+            // slabs go to one thread whole, nobody else carves them
+            cache.m_fresh = NewSlab();
+            cache.m_fresh_end = cache.m_fresh + m_block_size * m_blocks_per_slab;
+            taken = m_blocks_per_slab;
+        }
+        Take(taken);
+    }
+
+    // m_guard held
+    char* NewSlab()
+    {
+        const size_t bytes = m_block_size * m_blocks_per_slab;
+        void* slab = m_block_align > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+            ? ::operator new(bytes, std::align_val_t(m_block_align)) : ::operator new(bytes);
+        m_slabs.push_back(slab);
+        return static_cast<char*>(slab);
+    }
+
+    // m_guard held
+    void Take(size_t count)
+    {
+        m_outstanding += count;
+        m_peak_outstanding = std::max(m_peak_outstanding, m_outstanding);
+    }
+
+    // m_guard held
+    void Return(TCache& cache, size_t count)
+    {
+        for (size_t i = 0; i < count && cache.m_free; ++i)
+        {
+            auto block = static_cast<TFreeBlock*>(cache.Pop());
+            block->m_next = m_free;
+            m_free = block;
+            --m_outstanding;
+        }
+    }
+};
+
+// The SlabPool and the thread caches of everything allocated under TKey
+template <typename TKey>
+class KeyedPool
+{
+public:
+    // the first call sizes the pool
+    static SlabPool& Get(size_t block_size, size_t block_align)
+    {
+        // never destroyed: blocks may be freed by static objects destroyed after it would have been
+        static SlabPool* pool = Publish(new SlabPool(block_size, block_align));
+        return *pool;
+    }
+
+    // nullptr until the first Get
+    static const SlabPool* Find()
+    {
+        return Slot().load(std::memory_order_acquire);
+    }
+
+    // nullptr once the thread's cache has been destroyed, the allocator falls back to the locked calls then
+    static SlabPool::TCache* Cache(SlabPool& pool)
+    {
+        // trivially destructible, so it is still there after every other thread_local is gone
+        thread_local bool gone = false;
+        struct TLocalCache : SlabPool::TCache
+        {
+            using TCache::TCache;
+
+            ~TLocalCache()
+            {
+                gone = true;
+            }
+        };
+        if (gone)
+        {
+            return nullptr;
+        }
+        thread_local TLocalCache cache(pool);
+        return &cache;
+    }
+
+private:
+    static std::atomic<SlabPool*>& Slot()
+    {
+        static std::atomic<SlabPool*> slot{nullptr};
+        return slot;
+    }
+
+    static SlabPool* Publish(SlabPool* pool)
+    {
+        Slot().store(pool, std::memory_order_release);
+        return pool;
+    }
+};
+
+// Allocator that takes single objects from the pool of TKey. Rebinding keeps TKey, so the control block
+// std::allocate_shared allocates with it lands in the pool of the product type it was made for.
+// The pool is sized by the first single-object allocation; anything larger goes to the global heap.
+template <typename T, typename TKey = T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = PoolAllocator<U, TKey>;
+    };
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, TKey>&)
+    {}
+
+    T* allocate(size_t n)
+    {
+        if (n == 1 && alignof(T) <= alignof(std::max_align_t))
+        {
+            auto& pool = KeyedPool<TKey>::Get(sizeof(T), alignof(T));
+            if (sizeof(T) <= pool.BlockSize())
+            {
+                auto cache = KeyedPool<TKey>::Cache(pool);
+                return static_cast<T*>(cache ? cache->Allocate() : pool.AllocateLocked());
+            }
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        if (n == 1 && alignof(T) <= alignof(std::max_align_t))
+        {
+            auto& pool = KeyedPool<TKey>::Get(sizeof(T), alignof(T));
+            if (sizeof(T) <= pool.BlockSize())
+            {
+                if (auto cache = KeyedPool<TKey>::Cache(pool))
+                {
+                    cache->Deallocate(ptr);
+                }
+                else
+                {
+                    pool.DeallocateLocked(ptr);
+                }
+                return;
+            }
+        }
+        std::allocator<T>().deallocate(ptr, n);
+    }
+};
+
+template <typename T, typename U, typename TKey>
+bool operator==(const PoolAllocator<T, TKey>&, const PoolAllocator<U, TKey>&)
+{
+    return true;
+}
+
+template <typename T, typename U, typename TKey>
+bool operator!=(const PoolAllocator<T, TKey>&, const PoolAllocator<U, TKey>&)
+{
+    return false;
+}
+
+// make_shared from the product type's pool, the product and its control block in a single block
+template <typename TProduct, typename... TArgs>
+std::shared_ptr<TProduct> MakePooled(TArgs&&... args)
+{
+    return std::allocate_shared<TProduct>(PoolAllocator<TProduct>(), std::forward<TArgs>(args)...);
+}
+
+// stats of the pool MakePooled<TProduct> allocates from, all zero before the first product
+template <typename TProduct>
+PoolStats PooledStats()
+{
+    const SlabPool* pool = KeyedPool<TProduct>::Find();
+    return pool ? pool->Stats() : PoolStats();
+}
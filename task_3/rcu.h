@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "ring_buffer.h"
+
+// Minimal read-copy-update. Readers bump a counter on their own cache line for the duration
+// of a read section, writers publish a new version and then Synchronize, which waits for every
+// reader that might still see the old one. Counters come in two phases flipped by the writer,
+// so a steady stream of new readers can't starve it.
+class RcuDomain
+{
+public:
+    static RcuDomain& Instance()
+    {
+        static RcuDomain domain;
+        return domain;
+    }
+
+    RcuDomain(const RcuDomain&) = delete;
+    RcuDomain& operator=(const RcuDomain&) = delete;
+
+    // returns the phase to hand back to ReadUnlock
+    size_t ReadLock()
+    {
+        const size_t phase = m_phase.load(std::memory_order_relaxed) & 1;
+        // seq_cst pairs with the writer's publication: either it sees this reader or the reader sees the new version
+        LocalStripe().m_readers[phase].fetch_add(1, std::memory_order_seq_cst);
+        return phase;
+    }
+
+    void ReadUnlock(size_t phase)
+    {
+        LocalStripe().m_readers[phase].fetch_sub(1, std::memory_order_release);
+    }
+
+    // waits until every read section that started before the call is over; mustn't be called from one
+    void Synchronize()
+    {
+        std::lock_guard<std::mutex> l(m_writer_guard);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // a reader may have read the phase just before a flip, so both phases are drained
+        for (int flip = 0; flip < 2; ++flip)
+        {
+            const size_t old_phase = m_phase.fetch_add(1, std::memory_order_seq_cst) & 1;
+            for (unsigned spins = 0; Readers(old_phase) != 0; ++spins)
+            {
+                if (spins < 64)
+                {
+                    CpuRelax();
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr size_t num_stripes = 64;
+
+    struct alignas(cache_line) TStripe
+    {
+        std::atomic<uint64_t> m_readers[2] = {};
+    };
+
+    std::atomic<size_t> m_phase{0};
+    std::atomic<size_t> m_next_stripe{0};
+    TStripe m_stripes[num_stripes];
+    std::mutex m_writer_guard;
+
+    RcuDomain() = default;
+
+    // threads take stripes round robin, so up to num_stripes readers never share a line
+    TStripe& LocalStripe()
+    {
+        thread_local size_t stripe = m_next_stripe.fetch_add(1, std::memory_order_relaxed) % num_stripes;
+        return m_stripes[stripe];
+    }
+
+    uint64_t Readers(size_t phase) const
+    {
+        uint64_t readers = 0;
+        for (const auto& stripe : m_stripes)
+        {
+            readers += stripe.m_readers[phase].load(std::memory_order_seq_cst);
+        }
+        return readers;
+    }
+};
+
+// read section for the lifetime of the guard
+class RcuReadGuard
+{
+public:
+    RcuReadGuard()
+        : m_phase(RcuDomain::Instance().ReadLock())
+    {}
+
+    ~RcuReadGuard()
+    {
+        RcuDomain::Instance().ReadUnlock(m_phase);
+    }
+
+    RcuReadGuard(const RcuReadGuard&) = delete;
+    RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+
+private:
+    size_t m_phase;
+};
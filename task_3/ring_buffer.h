@@ -0,0 +1,447 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+constexpr size_t cache_line = 64;
+
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Event count the blocking strategies sleep on. Notify costs a fence and a load
+// unless somebody is actually asleep, so queues can call it after every operation.
+class WaitEvent
+{
+public:
+    // sleeps until ready() returns true, ready() is retried after every wakeup
+    template <typename TReady>
+    void Block(TReady&& ready)
+    {
+        while (true)
+        {
+            const uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            // a registration left behind here costs the next Notify one spurious wakeup at most
+            if (ready())
+            {
+                return;
+            }
+            Sleep(epoch);
+            if (ready())
+            {
+                return;
+            }
+        }
+    }
+
+    void Notify()
+    {
+        // pairs with the seq_cst increment in Block: either the sleeper sees the new state or we see the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // sleepers are woken once, notifications before they get to run again don't pay for a syscall
+        if (m_waiters.load(std::memory_order_relaxed) != 0 && m_waiters.exchange(0, std::memory_order_acq_rel) != 0)
+        {
+            m_epoch.fetch_add(1, std::memory_order_release);
+            Wake();
+        }
+    }
+
+private:
+    alignas(cache_line) std::atomic<uint32_t> m_epoch{0};
+    std::atomic<uint32_t> m_waiters{0};
+
+#ifdef __linux__
+    void Sleep(uint32_t epoch)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, epoch, nullptr, nullptr, 0);
+    }
+
+    void Wake()
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+#else
+    void Sleep(uint32_t epoch)
+    {
+        while (m_epoch.load(std::memory_order_acquire) == epoch)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void Wake()
+    {}
+#endif
+};
+
+// Wait strategies for the blocking Push/Pop of the queues
+
+// busy-waits, yielding now and then so that an oversubscribed machine still makes progress
+struct SpinWait
+{
+    static constexpr bool notifies = false;
+
+    template <typename TReady>
+    static void Wait(WaitEvent&, TReady&& ready)
+    {
+        for (unsigned spins = 1; !ready(); ++spins)
+        {
+            if (spins % 1024 == 0)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                CpuRelax();
+            }
+        }
+    }
+};
+
+// goes to sleep on a futex right away
+struct BlockWait
+{
+    static constexpr bool notifies = true;
+
+    template <typename TReady>
+    static void Wait(WaitEvent& event, TReady&& ready)
+    {
+        event.Block(ready);
+    }
+};
+
+// spins for a short while, then sleeps on a futex
+struct HybridWait
+{
+    static constexpr bool notifies = true;
+    static constexpr unsigned spin_limit = 256;
+
+    template <typename TReady>
+    static void Wait(WaitEvent& event, TReady&& ready)
+    {
+        for (unsigned spins = 0; spins < spin_limit; ++spins)
+        {
+            if (ready())
+            {
+                return;
+            }
+            CpuRelax();
+        }
+        event.Block(ready);
+    }
+};
+
+inline size_t RoundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Head and tail live on their own cache lines, and each side keeps a cached copy
+// of the other one's index, so the shared lines are touched only when the cached view runs out.
+template <typename T, typename TWait = HybridWait>
+class SpscQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity)
+        : m_mask(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1)
+        , m_slots(new TSlot[m_mask + 1])
+    {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    ~SpscQueue()
+    {
+        T value;
+        while (TryPop(value))
+        {}
+    }
+
+    size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // value is moved from only on success
+    bool TryPush(T& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == Capacity())
+        {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == Capacity())
+            {
+                return false;
+            }
+        }
+        new (&m_slots[tail & m_mask]) T(std::move(value));
+        m_tail.store(tail + 1, std::memory_order_release);
+        if constexpr (TWait::notifies)
+        {
+            m_not_empty.Notify();
+        }
+        return true;
+    }
+
+    bool TryPush(T&& value)
+    {
+        return TryPush(value);
+    }
+
+    bool TryPop(T& out)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail)
+        {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail)
+            {
+                return false;
+            }
+        }
+        T* item = std::launder(reinterpret_cast<T*>(&m_slots[head & m_mask]));
+        out = std::move(*item);
+        item->~T();
+        m_head.store(head + 1, std::memory_order_release);
+        if constexpr (TWait::notifies)
+        {
+            m_not_full.Notify();
+        }
+        return true;
+    }
+
+    void Push(T value)
+    {
+        if (!TryPush(value))
+        {
+            TWait::Wait(m_not_full, [&]() { return TryPush(value); });
+        }
+    }
+
+    T Pop()
+    {
+        T value;
+        if (!TryPop(value))
+        {
+            TWait::Wait(m_not_empty, [&]() { return TryPop(value); });
+        }
+        return value;
+    }
+
+private:
+    using TSlot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    const size_t m_mask;
+    const std::unique_ptr<TSlot[]> m_slots;
+
+    // consumer side
+    alignas(cache_line) std::atomic<size_t> m_head{0};
+    size_t m_cached_tail = 0;
+    // producer side
+    alignas(cache_line) std::atomic<size_t> m_tail{0};
+    size_t m_cached_head = 0;
+
+    WaitEvent m_not_empty;
+    WaitEvent m_not_full;
+};
+
+// Bounded lock-free queue for any number of producers and consumers (Vyukov's sequenced ring).
+// Every cell carries a sequence number telling whose turn it is, so a producer and a consumer
+// contend on the same cell only when the queue is full or empty.
+template <typename T, typename TWait = HybridWait>
+class MpmcQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit MpmcQueue(size_t capacity)
+        : m_mask(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1)
+        , m_cells(new TCell[m_mask + 1])
+    {
+        for (size_t i = 0; i <= m_mask; ++i)
+        {
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    ~MpmcQueue()
+    {
+        T value;
+        while (TryPop(value))
+        {}
+    }
+
+    size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // approximate number of queued items
+    size_t Size() const
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    // wakes every blocked consumer, Pop(T&) drains what is left and then fails
+    void Close()
+    {
+        m_closed.store(true, std::memory_order_seq_cst);
+        m_not_empty.Notify();
+        m_not_full.Notify();
+    }
+
+    bool Closed() const
+    {
+        return m_closed.load(std::memory_order_seq_cst);
+    }
+
+    // value is moved from only on success
+    bool TryPush(T& value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            TCell& cell = m_cells[pos & m_mask];
+            const size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    new (&cell.m_storage) T(std::move(value));
+                    cell.m_sequence.store(pos + 1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        if constexpr (TWait::notifies)
+        {
+            m_not_empty.Notify();
+        }
+        return true;
+    }
+
+    bool TryPush(T&& value)
+    {
+        return TryPush(value);
+    }
+
+    bool TryPop(T& out)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            TCell& cell = m_cells[pos & m_mask];
+            const size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    T* item = std::launder(reinterpret_cast<T*>(&cell.m_storage));
+                    out = std::move(*item);
+                    item->~T();
+                    cell.m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        if constexpr (TWait::notifies)
+        {
+            m_not_full.Notify();
+        }
+        return true;
+    }
+
+    void Push(T value)
+    {
+        if (!TryPush(value))
+        {
+            TWait::Wait(m_not_full, [&]() { return TryPush(value); });
+        }
+    }
+
+    T Pop()
+    {
+        T value;
+        if (!TryPop(value))
+        {
+            TWait::Wait(m_not_empty, [&]() { return TryPop(value); });
+        }
+        return value;
+    }
+
+    // blocks until there is an item or the queue is closed and drained, false in the latter case
+    bool Pop(T& out)
+    {
+        bool popped = TryPop(out);
+        if (!popped)
+        {
+            TWait::Wait(m_not_empty, [&]() { return (popped = TryPop(out)) || Closed(); });
+        }
+        // items pushed before Close are visible once it is
+        return popped || TryPop(out);
+    }
+
+private:
+    struct TCell
+    {
+        std::atomic<size_t> m_sequence;
+        std::aligned_storage_t<sizeof(T), alignof(T)> m_storage;
+    };
+
+    const size_t m_mask;
+    const std::unique_ptr<TCell[]> m_cells;
+
+    alignas(cache_line) std::atomic<size_t> m_head{0};
+    alignas(cache_line) std::atomic<size_t> m_tail{0};
+
+    std::atomic<bool> m_closed{false};
+    WaitEvent m_not_empty;
+    WaitEvent m_not_full;
+};
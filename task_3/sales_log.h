@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "type_registry.h"
+
+// Fixed-size binary record of one sale. The type is a TypeId of the process that wrote it,
+// so names can only be resolved by that process.
+struct SaleRecord
+{
+    // steady clock nanoseconds, for ordering records within a run; not a wall clock time
+    uint64_t m_time_ns = 0;
+    int32_t m_shop = 0;
+    TypeId m_type = invalid_type_id;
+    double m_price = 0;
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+static_assert(sizeof(SaleRecord) == 24, "sale records are written as is");
+
+// "1 sell A: 15", the line SellAll used to print
+inline std::ostream& operator<<(std::ostream& out, const SaleRecord& record)
+{
+    return out << record.m_shop << " sell " << TypeRegistry::Instance().Name(record.m_type) << ": " << record.m_price;
+}
+
+// Where the writer thread of a SalesLog puts records. Only ever called from that thread.
+class ISalesSink
+{
+public:
+    virtual ~ISalesSink() = default;
+
+    virtual void Write(const SaleRecord* records, size_t count) = 0;
+
+    virtual void Flush()
+    {}
+};
+
+// one line per record, written with a single call per batch
+class TextSalesSink : public ISalesSink
+{
+public:
+    explicit TextSalesSink(std::ostream& out)
+        : m_out(out)
+    {}
+
+    void Write(const SaleRecord* records, size_t count)
+    {
+        m_text.str(std::string());
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_text << records[i] << '\n';
+        }
+        const auto text = m_text.str();
+        m_out.write(text.data(), text.size());
+    }
+
+    void Flush()
+    {
+        m_out.flush();
+    }
+
+private:
+    std::ostream& m_out;
+    std::ostringstream m_text;
+};
+
+// A header of magic and record size, followed by the records in native byte order.
+class BinarySalesFile : public ISalesSink
+{
+public:
+    static constexpr uint32_t magic = 0x53414c45;
+
+    explicit BinarySalesFile(const std::string& path)
+        : m_file(std::fopen(path.c_str(), "wb"))
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("can't open " + path);
+        }
+        // the writer hands over large batches already, stdio only has to coalesce small ones
+        std::setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+        const uint32_t header[] = {magic, sizeof(SaleRecord)};
+        std::fwrite(header, sizeof(header), 1, m_file);
+    }
+
+    BinarySalesFile(const BinarySalesFile&) = delete;
+    BinarySalesFile& operator=(const BinarySalesFile&) = delete;
+
+    ~BinarySalesFile()
+    {
+        std::fclose(m_file);
+    }
+
+    void Write(const SaleRecord* records, size_t count)
+    {
+        std::fwrite(records, sizeof(SaleRecord), count, m_file);
+    }
+
+    void Flush()
+    {
+        std::fflush(m_file);
+    }
+
+    static std::vector<SaleRecord> Read(const std::string& path)
+    {
+        std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "rb"), std::fclose);
+        uint32_t header[2] = {};
+        if (!file || std::fread(header, sizeof(header), 1, file.get()) != 1
+            || header[0] != magic || header[1] != sizeof(SaleRecord))
+        {
+            throw std::runtime_error("not a sales file: " + path);
+        }
+        std::vector<SaleRecord> records;
+        SaleRecord record;
+        while (std::fread(&record, sizeof(record), 1, file.get()) == 1)
+        {
+            records.push_back(record);
+        }
+        return records;
+    }
+
+private:
+    FILE* m_file;
+};
+
+// Sales log with a lock-free SPSC buffer per appending thread and a background writer that drains
+// them into the sink every interval, sorting each batch by time. Append never blocks and makes no
+// system call; when a thread's buffer is full the record is dropped and counted in Dropped.
+// Flush and the destructor wait until everything appended before them has reached the sink.
+class SalesLog
+{
+public:
+    explicit SalesLog(std::unique_ptr<ISalesSink> sink, size_t buffer_capacity = 8192,
+        std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+        : m_id(NextId())
+        , m_sink(std::move(sink))
+        , m_buffer_capacity(buffer_capacity)
+        , m_interval(interval)
+        , m_writer([this]() { Write(); })
+    {}
+
+    SalesLog(const SalesLog&) = delete;
+    SalesLog& operator=(const SalesLog&) = delete;
+
+    ~SalesLog()
+    {
+        {
+            std::lock_guard<std::mutex> l(m_writer_guard);
+            m_stopping = true;
+        }
+        m_wakeup.notify_one();
+        m_writer.join();
+    }
+
+    // false if the record was dropped
+    bool Append(const SaleRecord& record)
+    {
+        auto& buffer = LocalBuffer();
+        if (buffer.m_records.TryPush(SaleRecord(record)))
+        {
+            return true;
+        }
+        buffer.m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void Flush()
+    {
+        std::unique_lock<std::mutex> l(m_writer_guard);
+        const uint64_t ticket = ++m_flush_requested;
+        m_wakeup.notify_one();
+        m_flushed_cv.wait(l, [&]() { return m_flushed >= ticket; });
+    }
+
+    uint64_t Dropped() const
+    {
+        std::lock_guard<std::mutex> l(m_buffers_guard);
+        uint64_t dropped = m_dropped_by_gone;
+        for (const auto& buffer : m_buffers)
+        {
+            dropped += buffer->m_dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+private:
+    struct TBuffer
+    {
+        explicit TBuffer(size_t capacity)
+            : m_records(capacity)
+        {}
+
+        SpscQueue<SaleRecord, SpinWait> m_records;
+        std::atomic<uint64_t> m_dropped{0};
+    };
+
+    // buffers of the thread by log id; a log lets go of the buffers of threads that exited
+    // and a thread of those of logs that are gone, whichever notices first
+    using TLocalBuffers = std::vector<std::pair<uint64_t, std::shared_ptr<TBuffer>>>;
+
+    const uint64_t m_id;
+    const std::unique_ptr<ISalesSink> m_sink;
+    const size_t m_buffer_capacity;
+    const std::chrono::milliseconds m_interval;
+
+    mutable std::mutex m_buffers_guard;
+    std::vector<std::shared_ptr<TBuffer>> m_buffers;
+    uint64_t m_dropped_by_gone = 0;
+
+    std::mutex m_writer_guard;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_flushed_cv;
+    bool m_stopping = false;
+    uint64_t m_flush_requested = 0;
+    uint64_t m_flushed = 0;
+
+    // writer only
+    std::vector<SaleRecord> m_batch;
+    std::thread m_writer;
+
+    static uint64_t NextId()
+    {
+        static std::atomic<uint64_t> next_id{0};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TBuffer& LocalBuffer()
+    {
+        thread_local TLocalBuffers local;
+        for (auto& entry : local)
+        {
+            if (entry.first == m_id)
+            {
+                return *entry.second;
+            }
+        }
+        local.erase(std::remove_if(local.begin(), local.end(), [](const auto& entry) {
+            return entry.second.use_count() == 1;
+        }), local.end());
+        auto buffer = std::make_shared<TBuffer>(m_buffer_capacity);
+        {
+            std::lock_guard<std::mutex> l(m_buffers_guard);
+            m_buffers.push_back(buffer);
+        }
+        local.emplace_back(m_id, buffer);
+        return *local.back().second;
+    }
+
+    void Write()
+    {
+        std::unique_lock<std::mutex> l(m_writer_guard);
+        while (true)
+        {
+            m_wakeup.wait_for(l, m_interval, [&]() { return m_stopping || m_flush_requested != m_flushed; });
+            const uint64_t ticket = m_flush_requested;
+            const bool stopping = m_stopping;
+            l.unlock();
+            // anything appended before the ticket was taken is in the buffers by now
+            if (Drain() || ticket != m_flushed)
+            {
+                m_sink->Flush();
+            }
+            l.lock();
+            m_flushed = ticket;
+            m_flushed_cv.notify_all();
+            if (stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    // true if anything was written
+    bool Drain()
+    {
+        std::vector<std::shared_ptr<TBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> l(m_buffers_guard);
+            buffers = m_buffers;
+            // a buffer held by nobody else belongs to a thread that is gone, this pass drains it for the last time
+            m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), [&](const auto& buffer) {
+                if (buffer.use_count() != 2)
+                {
+                    return false;
+                }
+                m_dropped_by_gone += buffer->m_dropped.load(std::memory_order_relaxed);
+                return true;
+            }), m_buffers.end());
+        }
+        // pairs with the owner's release of its reference
+        std::atomic_thread_fence(std::memory_order_acquire);
+        m_batch.clear();
+        SaleRecord record;
+        for (const auto& buffer : buffers)
+        {
+            while (buffer->m_records.TryPop(record))
+            {
+                m_batch.push_back(record);
+            }
+        }
+        if (!m_batch.empty())
+        {
+            std::stable_sort(m_batch.begin(), m_batch.end(), [](const SaleRecord& lhs, const SaleRecord& rhs) {
+                return lhs.m_time_ns < rhs.m_time_ns;
+            });
+            m_sink->Write(m_batch.data(), m_batch.size());
+        }
+        return !m_batch.empty();
+    }
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ring_buffer.h"
+#include "thread_pool.h"
+#include "type_registry.h"
+
+struct ShopSales
+{
+    uint64_t m_sold = 0;
+    // sales of products the shop doesn't list or that are off sale
+    uint64_t m_failed = 0;
+    double m_revenue = 0;
+};
+
+// Shops partitioned into shards by number, shop % shards. Every shard is one thread, optionally pinned
+// to a core, that owns the state of its shops and its own copy of the product table, and takes everything
+// that touches them as messages from its queue, so none of that state is shared or locked.
+// Products are known by TypeId only: price and sale changes go to every shard, attach, detach and sales
+// to the shard of the shop. Messages from one thread are handled in the order they were posted.
+class ShopEngine
+{
+public:
+    explicit ShopEngine(size_t num_shops, size_t num_shards = std::thread::hardware_concurrency(),
+        bool pin = true, size_t queue_capacity = 4096)
+        : m_num_shops(num_shops)
+    {
+        num_shards = std::max<size_t>(1, num_shards);
+        for (size_t i = 0; i < num_shards; ++i)
+        {
+            m_shards.push_back(std::make_unique<TShard>(queue_capacity));
+        }
+        for (size_t i = 0; i < num_shards; ++i)
+        {
+            m_shards[i]->m_thread = std::thread([this, i, pin]() { Work(i, pin); });
+        }
+    }
+
+    ShopEngine(const ShopEngine&) = delete;
+    ShopEngine& operator=(const ShopEngine&) = delete;
+
+    // handles every message posted before
+    ~ShopEngine()
+    {
+        for (auto& shard : m_shards)
+        {
+            shard->m_queue.Close();
+        }
+        for (auto& shard : m_shards)
+        {
+            shard->m_thread.join();
+        }
+    }
+
+    size_t Shops() const
+    {
+        return m_num_shops;
+    }
+
+    size_t Shards() const
+    {
+        return m_shards.size();
+    }
+
+    size_t ShardOf(size_t shop) const
+    {
+        return shop % m_shards.size();
+    }
+
+    void Attach(size_t shop, TypeId type)
+    {
+        PostToShop(shop, {TMessage::TKind::Attach, type, shop});
+    }
+
+    void Detach(size_t shop, TypeId type)
+    {
+        PostToShop(shop, {TMessage::TKind::Detach, type, shop});
+    }
+
+    void ChangePrice(TypeId type, double price)
+    {
+        PostToAll({TMessage::TKind::ChangePrice, type, 0, price});
+    }
+
+    void StartSales(TypeId type)
+    {
+        PostToAll({TMessage::TKind::StartSales, type});
+    }
+
+    void StopSales(TypeId type)
+    {
+        PostToAll({TMessage::TKind::StopSales, type});
+    }
+
+    // fire and forget, the outcome shows up in Sales
+    void Sell(size_t shop, TypeId type)
+    {
+        PostToShop(shop, {TMessage::TKind::Sell, type, shop});
+    }
+
+    // waits until every message posted before the call has been handled
+    void Flush()
+    {
+        std::vector<std::future<void>> done;
+        for (auto& shard : m_shards)
+        {
+            done.push_back(Call(*shard, []() {}));
+        }
+        for (auto& shard_done : done)
+        {
+            shard_done.get();
+        }
+    }
+
+    // counters of the shop after every message posted before the call
+    ShopSales Sales(size_t shop)
+    {
+        CheckShop(shop);
+        auto& shard = *m_shards[ShardOf(shop)];
+        return Call(shard, [this, &shard, shop]() { return shard.m_state->m_shops[LocalIndex(shop)].m_sales; }).get();
+    }
+
+private:
+    struct TMessage
+    {
+        enum class TKind : uint8_t
+        {
+            Attach,
+            Detach,
+            ChangePrice,
+            StartSales,
+            StopSales,
+            Sell,
+            Call,
+        };
+
+        TKind m_kind = TKind::Call;
+        TypeId m_type = invalid_type_id;
+        size_t m_shop = 0;
+        double m_price = 0;
+        // call only, run and deleted by the shard
+        PoolTask* m_task = nullptr;
+    };
+
+    struct TShop
+    {
+        // listed flags by TypeId, grown on attach
+        std::vector<uint8_t> m_listed;
+        ShopSales m_sales;
+    };
+
+    struct TProduct
+    {
+        double m_price = 0;
+        bool m_on_sale = false;
+    };
+
+    // owned and touched by the shard thread only
+    struct TShardState
+    {
+        explicit TShardState(size_t num_shops)
+            : m_shops(num_shops)
+        {}
+
+        std::vector<TShop> m_shops;
+        // product table by TypeId, grown on first mention
+        std::vector<TProduct> m_products;
+    };
+
+    struct TShard
+    {
+        explicit TShard(size_t queue_capacity)
+            : m_queue(queue_capacity)
+        {}
+
+        MpmcQueue<TMessage, HybridWait> m_queue;
+        std::thread m_thread;
+        std::unique_ptr<TShardState> m_state;
+    };
+
+    const size_t m_num_shops;
+    std::vector<std::unique_ptr<TShard>> m_shards;
+
+    size_t LocalIndex(size_t shop) const
+    {
+        return shop / m_shards.size();
+    }
+
+    void CheckShop(size_t shop) const
+    {
+        if (shop >= m_num_shops)
+        {
+            throw std::out_of_range("no such shop");
+        }
+    }
+
+    void PostToShop(size_t shop, const TMessage& message)
+    {
+        CheckShop(shop);
+        m_shards[ShardOf(shop)]->m_queue.Push(message);
+    }
+
+    void PostToAll(const TMessage& message)
+    {
+        for (auto& shard : m_shards)
+        {
+            shard->m_queue.Push(message);
+        }
+    }
+
+    template <typename TFunc>
+    auto Call(TShard& shard, TFunc func) -> std::future<std::invoke_result_t<TFunc&>>
+    {
+        std::packaged_task<std::invoke_result_t<TFunc&>()> task(std::move(func));
+        auto result = task.get_future();
+        TMessage message;
+        message.m_task = new FunctionTask<decltype(task)>(std::move(task));
+        shard.m_queue.Push(message);
+        return result;
+    }
+
+    static void Pin(size_t index)
+    {
+#ifdef __linux__
+        const unsigned cores = std::thread::hardware_concurrency();
+        if (cores > 0)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(index % cores, &cpus);
+            // best effort, e.g. the cpuset of a container may not have that core
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+#else
+        (void)index;
+#endif
+    }
+
+    void Work(size_t index, bool pin)
+    {
+        if (pin)
+        {
+            Pin(index);
+        }
+        TShard& shard = *m_shards[index];
+        // allocated after pinning, so first touch puts the shard's state on the memory node of its core
+        const size_t num_local_shops = m_num_shops / m_shards.size() + (index < m_num_shops % m_shards.size());
+        shard.m_state = std::make_unique<TShardState>(num_local_shops);
+        TMessage message;
+        while (shard.m_queue.Pop(message))
+        {
+            Handle(*shard.m_state, message);
+        }
+    }
+
+    void Handle(TShardState& state, const TMessage& message)
+    {
+        switch (message.m_kind)
+        {
+        case TMessage::TKind::Attach:
+            SetListed(state.m_shops[LocalIndex(message.m_shop)], message.m_type, true);
+            break;
+        case TMessage::TKind::Detach:
+            SetListed(state.m_shops[LocalIndex(message.m_shop)], message.m_type, false);
+            break;
+        case TMessage::TKind::ChangePrice:
+            Product(state, message.m_type).m_price = message.m_price;
+            break;
+        case TMessage::TKind::StartSales:
+            Product(state, message.m_type).m_on_sale = true;
+            break;
+        case TMessage::TKind::StopSales:
+            Product(state, message.m_type).m_on_sale = false;
+            break;
+        case TMessage::TKind::Sell:
+            Sell(state, state.m_shops[LocalIndex(message.m_shop)], message.m_type);
+            break;
+        case TMessage::TKind::Call:
+            message.m_task->Run();
+            delete message.m_task;
+            break;
+        }
+    }
+
+    static TProduct& Product(TShardState& state, TypeId type)
+    {
+        if (type >= state.m_products.size())
+        {
+            state.m_products.resize(type + 1);
+        }
+        return state.m_products[type];
+    }
+
+    static void SetListed(TShop& shop, TypeId type, bool listed)
+    {
+        if (type >= shop.m_listed.size())
+        {
+            if (!listed)
+            {
+                return;
+            }
+            shop.m_listed.resize(type + 1);
+        }
+        shop.m_listed[type] = listed;
+    }
+
+    static void Sell(const TShardState& state, TShop& shop, TypeId type)
+    {
+        const bool listed = type < shop.m_listed.size() && shop.m_listed[type];
+        if (listed && type < state.m_products.size() && state.m_products[type].m_on_sale)
+        {
+            ++shop.m_sales.m_sold;
+            shop.m_sales.m_revenue += state.m_products[type].m_price;
+        }
+        else
+        {
+            ++shop.m_sales.m_failed;
+        }
+    }
+};
@@ -8,15 +8,19 @@
 #include <chrono>
 #include <map>
 
+#include "sales_log.h"
 #include "shops.h"
+#include "thread_pool.h"
 
 using namespace std::chrono_literals;
 
 int main(int argc, char** argv)
 {
-    IShopImpl* shopPtr1 = new IShopImpl{1};   
-    IShopImpl* shopPtr2 = new IShopImpl{2};
-    IShopImpl* shopPtr3 = new IShopImpl{3};
+    // shops only append records, the log's writer thread does the printing
+    SalesLog log(std::make_unique<TextSalesSink>(std::cout));
+    IShopImpl* shopPtr1 = new IShopImpl{1, &log};   
+    IShopImpl* shopPtr2 = new IShopImpl{2, &log};
+    IShopImpl* shopPtr3 = new IShopImpl{3, &log};
 
     std::thread products([&]() {
         auto prod1 = std::make_shared<A>(15);
@@ -38,11 +42,18 @@ int main(int argc, char** argv)
         prod3->Attach(shopPtr1);
     });
 
+    // one pool task per shop and SellAll pass
+    ThreadPool pool;
     std::this_thread::sleep_for(0.5s);
     for (auto i = 0; i < 4; ++i) {
-        shopPtr1->SellAll();
-        shopPtr2->SellAll();
-        shopPtr3->SellAll();
+        std::vector<std::future<void>> passes;
+        for (auto shop : {shopPtr1, shopPtr2, shopPtr3}) {
+            passes.push_back(pool.Submit([shop]() { shop->SellAll(); }));
+        }
+        for (auto& pass : passes) {
+            pass.get();
+        }
+        log.Flush();
         std::cout << "------------" << std::endl;
         std::this_thread::sleep_for(1s);
     }
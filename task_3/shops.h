@@ -1,3 +1,5 @@
+#pragma once
+
 #include <atomic>
 #include <algorithm>
 #include <vector>
@@ -7,6 +9,13 @@
 #include <memory>
 #include <chrono>
 #include <map>
+#include <sstream>
+
+#include "catalogue.h"
+#include "price_inbox.h"
+#include "rcu.h"
+#include "sales_log.h"
+#include "type_registry.h"
 
 using namespace std::chrono_literals;
 
@@ -28,6 +37,7 @@ public:
     virtual double GetPrice() const = 0;
 
     virtual std::string GetType() const = 0;
+    virtual TypeId GetTypeId() const = 0;
 
     virtual void StartSales() = 0;
     virtual void StopSales() = 0;
@@ -36,60 +46,279 @@ public:
 
     virtual void Attach(IShop* shop) = 0;
     virtual void Detach(IShop* shop) = 0;
+
+    // price and sale state changes are published into a slot of each subscribed inbox, starting with
+    // the current state; returns the slot
+    virtual std::shared_ptr<const PriceSlot> Subscribe(std::shared_ptr<PriceInbox> inbox) = 0;
+    virtual void Unsubscribe(const std::shared_ptr<PriceInbox>& inbox) = 0;
+};
+
+// outcome of one item of a basket
+struct SaleResult
+{
+    double m_price = 0;
+    // false if the shop doesn't list the product or it is off sale
+    bool m_sold = false;
+};
+
+struct BasketTotals
+{
+    size_t m_sold = 0;
+    size_t m_failed = 0;
+    double m_revenue = 0;
 };
 
+// Sell and SellAll read an immutable catalogue snapshot inside an RCU read section and take no lock.
+// Catalogue changes copy the snapshot under m_prod_guard, publish the copy and free the old one
+// once no reader can see it, which is cheap enough for shops that sell far more often than they restock.
+// Listed products publish their price changes into slots of the shop's inbox that the catalogue entries
+// point at, so Sell and SellAll read only those, never the products themselves, and nothing has to be applied.
+// SellAll appends a record per sale to the shop's SalesLog if it has one, and prints the sales otherwise
+// and those the log drops.
 class IShopImpl : public IShop
 {
 public:
-    IShopImpl(int number) : m_number(number)
+    IShopImpl(int number, SalesLog* log = nullptr)
+        : m_number(number), m_catalogue(new Catalogue()), m_inbox(std::make_shared<PriceInbox>()), m_log(log)
     {}
 
-    virtual ~IShopImpl() = default;
+    virtual ~IShopImpl()
+    {
+        // products let go of the inbox the next time they publish
+        m_inbox->Close();
+        delete m_catalogue.load(std::memory_order_relaxed);
+    }
 
     void AddProduct(IProduct& product)
     {
+        const TypeId type = product.GetTypeId();
         std::unique_lock<std::mutex> m(m_prod_guard);
-        m_products[product.GetType()] = product.shared_from_this();
+        Unsubscribe(type);
+        auto slot = product.Subscribe(m_inbox);
+        Publish(new Catalogue(Current().With(type, product.shared_from_this(), std::move(slot))));
     }
 
     void DelProduct(IProduct& product)
+    {
+        DelProduct(product.GetTypeId());
+    }
+
+    void DelProduct(TypeId type)
     {
         std::unique_lock<std::mutex> m(m_prod_guard);
-        m_products.erase(product.GetType());
+        Unsubscribe(type);
+        Publish(new Catalogue(Current().Without(type)));
     }
 
     void SellAll() const
     {
-        std::unique_lock<std::mutex> m(m_prod_guard);
-        for (auto iter : m_products)
+        // the prices Sell charges, a product that is gone has stopped its sales on the way out
+        if (m_log)
+        {
+            // sales the log has no room for are printed instead, after the read section
+            std::vector<SaleRecord> dropped;
+            {
+                RcuReadGuard guard;
+                for (const auto& entry : Current().Entries())
+                {
+                    const double price = entry.m_slot->SalePrice();
+                    if (price >= 0)
+                    {
+                        const SaleRecord record{SaleRecord::Now(), m_number, entry.m_type_id, price};
+                        if (!m_log->Append(record))
+                        {
+                            dropped.push_back(record);
+                        }
+                    }
+                }
+            }
+            if (!dropped.empty())
+            {
+                std::ostringstream text;
+                for (const auto& record : dropped)
+                {
+                    text << record << '\n';
+                }
+                const auto lines = text.str();
+                std::cout.write(lines.data(), lines.size());
+            }
+            return;
+        }
+        // without a log the pass is printed in one write after the read section
+        std::ostringstream text;
         {
-            // if started sale and product still exists, 
-            // shop prolongs lifetime of product using shared_ptr
-            auto sh_product = iter.second.lock();
-            if (sh_product && sh_product->OnSale()) 
+            RcuReadGuard guard;
+            for (const auto& entry : Current().Entries())
             {
-                std::cout << m_number << " sell " << sh_product->GetType()  << ": " << sh_product->GetPrice() << std::endl;
+                const double price = entry.m_slot->SalePrice();
+                if (price >= 0)
+                {
+                    text << SaleRecord{0, m_number, entry.m_type_id, price} << '\n';
+                }
             }
         }
+        const auto lines = text.str();
+        std::cout.write(lines.data(), lines.size());
     }
 
-    double Sell(std::string type)
+    // allocation-free: a bounds check and an index into the catalogue
+    double Sell(TypeId type)
     {
-        std::unique_lock<std::mutex> m(m_prod_guard);
-        if (m_products.find(type) != m_products.end()) 
+        return SellByKey(type);
+    }
+
+    double Sell(const std::string& type)
+    {
+        return SellByKey(type);
+    }
+
+    // Sells count items, out has to have room for as many results. The whole basket is resolved
+    // against one catalogue snapshot, at the prices its products publish meanwhile.
+    BasketTotals SellBatch(const TypeId* types, size_t count, SaleResult* out)
+    {
+        return SellBatchByKey(types, count, out);
+    }
+
+    BasketTotals SellBatch(const std::string* types, size_t count, SaleResult* out)
+    {
+        return SellBatchByKey(types, count, out);
+    }
+
+    // totals of Sell and SellBatch so far, the two may be a sale apart when read during one
+    double Revenue() const
+    {
+        double revenue = 0;
+        for (const auto& counters : m_counters)
         {
-            auto sh_product = m_products[type].lock();
-            if (sh_product && sh_product->OnSale()) 
-            {
-                return sh_product->GetPrice();
-            }
+            revenue += counters.m_revenue.load(std::memory_order_relaxed);
+        }
+        return revenue;
+    }
+
+    uint64_t UnitsSold() const
+    {
+        uint64_t units = 0;
+        for (const auto& counters : m_counters)
+        {
+            units += counters.m_units_sold.load(std::memory_order_relaxed);
         }
-        return -1;
+        return units;
     }
 private:
+    static constexpr size_t num_counter_stripes = 16;
+
+    // written by selling threads, kept off the lines that are read-mostly and off each other's
+    struct alignas(cache_line) TCounters
+    {
+        std::atomic<double> m_revenue{0};
+        std::atomic<uint64_t> m_units_sold{0};
+    };
+
+
     int m_number;
     mutable std::mutex m_prod_guard;
-    std::map<std::string, std::weak_ptr<IProduct>> m_products;
+    std::atomic<const Catalogue*> m_catalogue;
+
+    std::shared_ptr<PriceInbox> m_inbox;
+    SalesLog* m_log;
+    TCounters m_counters[num_counter_stripes];
+
+    template <typename TKey>
+    double SellByKey(const TKey& type)
+    {
+        double price;
+        {
+            RcuReadGuard guard;
+            price = SalePrice(Current(), type);
+        }
+        if (price >= 0)
+        {
+            Count(1, price);
+        }
+        return price;
+    }
+
+    template <typename TKey>
+    BasketTotals SellBatchByKey(const TKey* types, size_t count, SaleResult* out)
+    {
+        BasketTotals totals;
+        {
+            RcuReadGuard guard;
+            const Catalogue& catalogue = Current();
+            for (size_t i = 0; i < count; ++i)
+            {
+                const double price = SalePrice(catalogue, types[i]);
+                if (price >= 0)
+                {
+                    out[i] = {price, true};
+                    ++totals.m_sold;
+                    totals.m_revenue += price;
+                }
+                else
+                {
+                    out[i] = {0, false};
+                    ++totals.m_failed;
+                }
+            }
+        }
+        if (totals.m_sold != 0)
+        {
+            Count(totals.m_sold, totals.m_revenue);
+        }
+        return totals;
+    }
+
+    // -1 if not for sale
+    template <typename TKey>
+    static double SalePrice(const Catalogue& catalogue, const TKey& type)
+    {
+        auto entry = catalogue.Find(type);
+        return entry ? entry->m_slot->SalePrice() : -1;
+    }
+
+    // counters only, nothing is ordered by them
+    void Count(uint64_t units, double revenue)
+    {
+        auto& counters = m_counters[CounterStripe()];
+        counters.m_units_sold.fetch_add(units, std::memory_order_relaxed);
+        // only threads that share the stripe ever retry
+        double total = counters.m_revenue.load(std::memory_order_relaxed);
+        while (!counters.m_revenue.compare_exchange_weak(total, total + revenue, std::memory_order_relaxed))
+        {}
+    }
+
+    // threads take stripes round robin, so up to num_counter_stripes sellers never share a line
+    static size_t CounterStripe()
+    {
+        static std::atomic<size_t> next_stripe{0};
+        thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % num_counter_stripes;
+        return stripe;
+    }
+
+    // m_prod_guard held
+    void Unsubscribe(TypeId type)
+    {
+        if (auto entry = Current().Find(type))
+        {
+            if (auto sh_product = entry->m_product.lock())
+            {
+                sh_product->Unsubscribe(m_inbox);
+            }
+        }
+    }
+
+    // seq_cst pairs with the RCU read lock, see RcuDomain
+    const Catalogue& Current() const
+    {
+        return *m_catalogue.load(std::memory_order_seq_cst);
+    }
+
+    void Publish(const Catalogue* next)
+    {
+        auto old = m_catalogue.exchange(next, std::memory_order_seq_cst);
+        RcuDomain::Instance().Synchronize();
+        delete old;
+    }
 };
 
 class IProductImpl : public IProduct
@@ -106,6 +335,7 @@ public:
     void ChangePrice(double value)
     {
         m_price = value;
+        Notify();
     }
     
     double GetPrice() const
@@ -116,10 +346,12 @@ public:
     void StartSales()
     {
         m_on_sale = true;
+        Notify();
     }
     void StopSales()
     {
         m_on_sale = false;
+        Notify();
     }
 
     bool OnSale() const 
@@ -127,6 +359,18 @@ public:
         return m_on_sale;
     }
 
+    // GetType is interned on first use, which is normally the first Attach
+    TypeId GetTypeId() const
+    {
+        auto id = m_type_id.load(std::memory_order_relaxed);
+        if (id == invalid_type_id)
+        {
+            id = TypeRegistry::Instance().Intern(GetType());
+            m_type_id.store(id, std::memory_order_relaxed);
+        }
+        return id;
+    }
+
     void Attach(IShop* shop) 
     {
         if (shop) {
@@ -140,9 +384,60 @@ public:
             shop->DelProduct(*this);
         }
     }
+
+    std::shared_ptr<const PriceSlot> Subscribe(std::shared_ptr<PriceInbox> inbox)
+    {
+        auto slot = inbox->Open(GetTypeId());
+        std::unique_lock<std::mutex> m(m_subscribers_guard);
+        inbox->Publish(*slot, SalePrice());
+        m_subscribers.push_back({std::move(inbox), slot});
+        return slot;
+    }
+
+    void Unsubscribe(const std::shared_ptr<PriceInbox>& inbox)
+    {
+        std::unique_lock<std::mutex> m(m_subscribers_guard);
+        m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(), [&](const auto& subscription) {
+            return subscription.m_inbox == inbox;
+        }), m_subscribers.end());
+    }
 private:
+    struct TSubscription
+    {
+        std::shared_ptr<PriceInbox> m_inbox;
+        std::shared_ptr<PriceSlot> m_slot;
+    };
+
     std::atomic<double> m_price;
-    std::atomic<bool> m_on_sale;
+    std::atomic<bool> m_on_sale{false};
+    std::mutex m_subscribers_guard;
+    std::vector<TSubscription> m_subscribers;
+
+    // never calls GetType, which matters when the destructor stops sales
+    double SalePrice() const
+    {
+        return m_on_sale.load() ? m_price.load() : -1;
+    }
+
+    // the state is read under the lock, so every inbox gets the changes in the order they happened
+    void Notify()
+    {
+        std::unique_lock<std::mutex> m(m_subscribers_guard);
+        if (m_subscribers.empty())
+        {
+            return;
+        }
+        const double sale_price = SalePrice();
+        m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(), [&](const auto& subscription) {
+            if (subscription.m_inbox->Closed())
+            {
+                return true;
+            }
+            subscription.m_inbox->Publish(*subscription.m_slot, sale_price);
+            return false;
+        }), m_subscribers.end());
+    }
+    mutable std::atomic<TypeId> m_type_id{invalid_type_id};
 };
 
 class A : public IProductImpl {
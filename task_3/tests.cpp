@@ -1,6 +1,17 @@
 #include <gtest/gtest.h>
 
+#include <cstdlib>
+#include <numeric>
+#include <unistd.h>
+
+#include "channel.h"
+#include "pipeline.h"
+#include "product_pool.h"
+#include "ring_buffer.h"
+#include "sales_log.h"
+#include "shop_engine.h"
 #include "shops.h"
+#include "thread_pool.h"
 
 // g++ -std=c++17 -g -pthread shops.cpp -lgtest_main -lgtest -lpthread 
 // Used libgtest-dev package on Ubuntu. After apt installation:
@@ -53,6 +64,729 @@ TEST_F(Test, test4) {
     ASSERT_EQ(shop.Sell(product->GetType()), -1);
 }
 
+TEST_F(Test, test5) {
+    /** Ring buffers are FIFO, rounded up to a power of two, and reject pushes when full
+     */
+    SpscQueue<int> spsc(3);
+    MpmcQueue<int> mpmc(3);
+    ASSERT_EQ(spsc.Capacity(), 4u);
+    ASSERT_EQ(mpmc.Capacity(), 4u);
+    int value = 0;
+    ASSERT_FALSE(spsc.TryPop(value));
+    ASSERT_FALSE(mpmc.TryPop(value));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(spsc.TryPush(i));
+        ASSERT_TRUE(mpmc.TryPush(i));
+    }
+    ASSERT_FALSE(spsc.TryPush(4));
+    ASSERT_FALSE(mpmc.TryPush(4));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(spsc.Pop(), i);
+        ASSERT_EQ(mpmc.Pop(), i);
+    }
+    ASSERT_FALSE(spsc.TryPop(value));
+    ASSERT_FALSE(mpmc.TryPop(value));
+}
+
+template <typename TQueue>
+long long TransferSum(size_t producers, size_t consumers, int per_producer) {
+    TQueue queue(16);
+    std::vector<long long> sums(consumers);
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&]() {
+            for (int i = 1; i <= per_producer; ++i) {
+                queue.Push(i);
+            }
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c]() {
+            for (size_t i = 0; i < producers * per_producer / consumers; ++i) {
+                sums[c] += queue.Pop();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return std::accumulate(sums.begin(), sums.end(), 0LL);
+}
+
+TEST_F(Test, test6) {
+    /** Every item pushed through a small queue is popped exactly once, whatever the wait strategy
+     */
+    const int n = 20000;
+    const long long expected = 1LL * n * (n + 1) / 2;
+    ASSERT_EQ((TransferSum<SpscQueue<int, SpinWait>>(1, 1, n)), expected);
+    ASSERT_EQ((TransferSum<SpscQueue<int, BlockWait>>(1, 1, n)), expected);
+    ASSERT_EQ((TransferSum<SpscQueue<int, HybridWait>>(1, 1, n)), expected);
+    ASSERT_EQ((TransferSum<MpmcQueue<int, SpinWait>>(4, 4, n)), 4 * expected);
+    ASSERT_EQ((TransferSum<MpmcQueue<int, BlockWait>>(4, 4, n)), 4 * expected);
+    ASSERT_EQ((TransferSum<MpmcQueue<int, HybridWait>>(4, 2, n)), 4 * expected);
+}
+TEST_F(Test, test7) {
+    /** Channel pushes stop at the high watermark, batches come out in order, Close drains what is left
+     */
+    Channel<int> channel(16, 8, 2);
+    ASSERT_EQ(channel.Capacity(), 16u);
+    std::vector<int> items(12);
+    std::iota(items.begin(), items.end(), 0);
+    ASSERT_EQ(channel.TryPushBatch(items.data(), items.size()), 8u);
+    ASSERT_EQ(channel.TryPushBatch(items.data() + 8, 4), 0u);
+
+    std::vector<int> out(5);
+    ASSERT_EQ(channel.TryPopBatch(out.data(), out.size()), 5u);
+    ASSERT_EQ(out, std::vector<int>({0, 1, 2, 3, 4}));
+    ASSERT_EQ(channel.TryPushBatch(items.data() + 8, 4), 4u);
+
+    channel.Close();
+    ASSERT_FALSE(channel.Push(12));
+    std::vector<int> rest(16);
+    ASSERT_EQ(channel.PopBatch(rest.data(), rest.size()), 7u);
+    ASSERT_EQ(rest[0], 5);
+    ASSERT_EQ(rest[6], 11);
+    ASSERT_EQ(channel.PopBatch(rest.data(), rest.size()), 0u);
+}
+
+TEST_F(Test, test8) {
+    /** Batches of uneven sizes cross the channel between two threads without loss or reordering
+     */
+    Channel<int> channel(64, 32, 4);
+    const int n = 100000;
+    std::thread producer([&]() {
+        std::vector<int> batch;
+        for (int i = 0; i < n; ++i) {
+            batch.push_back(i);
+            if (batch.size() == size_t(i % 97 + 1)) {
+                channel.PushBatch(batch.data(), batch.size());
+                batch.clear();
+            }
+        }
+        channel.PushBatch(batch.data(), batch.size());
+        channel.Close();
+    });
+    int expected = 0;
+    bool ordered = true;
+    std::vector<int> batch(40);
+    while (size_t count = channel.PopBatch(batch.data(), expected % 40 + 1)) {
+        for (size_t i = 0; i < count; ++i) {
+            ordered = ordered && batch[i] == expected++;
+        }
+    }
+    producer.join();
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(expected, n);
+}
+TEST_F(Test, test9) {
+    /** Closing a multi-stage pipeline drains every item through every stage and counts it
+     */
+    auto pipeline = Pipeline<int>(8)
+        .Then("square", 3, [](int x) { return 1LL * x * x; })
+        .Then("describe", 2, [](long long x) { return std::to_string(x); });
+    const int n = 5000;
+    std::thread producer([&]() {
+        for (int i = 0; i < n; ++i) {
+            pipeline.Push(i);
+        }
+        pipeline.Close();
+    });
+    long long sum = 0;
+    std::string item;
+    while (pipeline.Pop(item)) {
+        sum += std::stoll(item);
+    }
+    producer.join();
+    ASSERT_EQ(sum, 1LL * (n - 1) * n * (2 * n - 1) / 6);
+    ASSERT_FALSE(pipeline.Push(n));
+
+    auto stats = pipeline.Stats();
+    ASSERT_EQ(stats.size(), 2u);
+    ASSERT_EQ(stats[0].m_name, "square");
+    ASSERT_EQ(stats[0].m_workers, 3u);
+    ASSERT_EQ(stats[0].m_items, uint64_t(n));
+    ASSERT_EQ(stats[1].m_items, uint64_t(n));
+    ASSERT_EQ(stats[1].m_queue_depth, 0u);
+}
+
+TEST_F(Test, test10) {
+    /** Ordered pipeline hands items out in input order however many workers a stage has
+     */
+    auto pipeline = Pipeline<int>(16, true)
+        .Then("jitter", 4, [](int x) {
+            if (x % 7 == 0) {
+                std::this_thread::yield();
+            }
+            return x;
+        });
+    std::thread producer([&]() {
+        for (int i = 0; i < 2000; ++i) {
+            pipeline.Push(i);
+        }
+        pipeline.Close();
+    });
+    int expected = 0;
+    bool ordered = true;
+    int item = 0;
+    while (pipeline.Pop(item)) {
+        ordered = ordered && item == expected++;
+    }
+    producer.join();
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(expected, 2000);
+}
+TEST_F(Test, test11) {
+    /** Pool futures carry results, tasks can submit and wait for more tasks without deadlocking
+     */
+    ThreadPool pool(2);
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i) {
+        results.push_back(pool.Submit([i]() { return i * i; }));
+    }
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(results[i].get(), i * i);
+    }
+
+    auto nested = pool.Submit([&pool]() {
+        std::atomic<int> count{0};
+        pool.ParallelFor(0, 64, [&](size_t) {
+            pool.ParallelFor(0, 64, [&](size_t) { count.fetch_add(1); }, 4);
+        }, 1);
+        return count.load();
+    });
+    ASSERT_EQ(nested.get(), 64 * 64);
+
+    auto failing = pool.Submit([]() -> int { throw std::runtime_error("task"); });
+    ASSERT_THROW(failing.get(), std::runtime_error);
+}
+
+TEST_F(Test, test12) {
+    /** ParallelReduce matches the serial result for any grain, ParallelFor rethrows a body exception
+     */
+    ThreadPool pool(3);
+    for (size_t grain : {0, 1, 7, 1000, 5000}) {
+        auto sum = pool.ParallelReduce(size_t(0), size_t(1000), 0LL,
+            [](size_t i) { return 1LL * i * i; },
+            [](long long a, long long b) { return a + b; }, grain);
+        ASSERT_EQ(sum, 332833500LL);
+    }
+    ASSERT_EQ(pool.ParallelReduce(size_t(5), size_t(5), 1, [](size_t) { return 2; }, std::multiplies<int>()), 1);
+    ASSERT_THROW(pool.ParallelFor(0, 100, [](size_t i) {
+        if (i == 42) {
+            throw std::out_of_range("body");
+        }
+    }), std::out_of_range);
+}
+TEST_F(Test, test13) {
+    /** Catalogue follows attach, replace, detach and product destruction
+     */
+    IShopImpl shop{ 1 };
+    auto a = std::make_shared<A>(10.0);
+    auto b = std::make_shared<B>(20.0);
+    a->StartSales();
+    b->StartSales();
+    a->Attach(&shop);
+    b->Attach(&shop);
+    ASSERT_EQ(shop.Sell("A"), 10.0);
+    ASSERT_EQ(shop.Sell("B"), 20.0);
+
+    auto other_a = std::make_shared<A>(11.0);
+    other_a->StartSales();
+    other_a->Attach(&shop);
+    ASSERT_EQ(shop.Sell("A"), 11.0);
+
+    b->Detach(&shop);
+    ASSERT_EQ(shop.Sell("B"), -1);
+    other_a.reset();
+    ASSERT_EQ(shop.Sell("A"), -1);
+    ASSERT_EQ(shop.Sell("C"), -1);
+}
+
+TEST_F(Test, test14) {
+    /** Readers keep selling while the catalogue changes under them
+     */
+    IShopImpl shop{ 1 };
+    auto a = std::make_shared<A>(10.0);
+    auto b = std::make_shared<B>(20.0);
+    a->StartSales();
+    b->StartSales();
+    a->Attach(&shop);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    std::atomic<long> sold_a{0};
+    std::atomic<long> bad{0};
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                sold_a += shop.Sell("A") == 10.0;
+                auto price = shop.Sell("B");
+                bad += price != -1 && price != 20.0;
+            }
+        });
+    }
+    for (int i = 0; i < 200 || sold_a.load() < 1000; ++i) {
+        b->Attach(&shop);
+        b->Detach(&shop);
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_GT(sold_a.load(), 0);
+    ASSERT_EQ(bad.load(), 0);
+}
+TEST_F(Test, test15) {
+    /** Type names are interned once, shops sell by id and by name alike
+     */
+    auto& registry = TypeRegistry::Instance();
+    auto a = std::make_shared<A>(10.0);
+    auto b = std::make_shared<B>(20.0);
+    ASSERT_EQ(a->GetTypeId(), registry.Intern("A"));
+    ASSERT_EQ(registry.Name(a->GetTypeId()), "A");
+    ASSERT_EQ(registry.Find("A"), a->GetTypeId());
+    ASSERT_EQ(registry.Find("no such type"), invalid_type_id);
+    ASSERT_EQ(registry.Name(invalid_type_id), "");
+    ASSERT_EQ(registry.Name(TypeId(registry.Size())), "");
+    ASSERT_NE(a->GetTypeId(), b->GetTypeId());
+
+    IShopImpl shop{ 1 };
+    a->StartSales();
+    shop.AddProduct(*a);
+    b->StartSales();
+    b->Attach(&shop);
+    ASSERT_EQ(shop.Sell(a->GetTypeId()), 10.0);
+    ASSERT_EQ(shop.Sell(b->GetTypeId()), 20.0);
+    ASSERT_EQ(shop.Sell("B"), 20.0);
+    ASSERT_EQ(shop.Sell(registry.Intern("never attached")), -1);
+    ASSERT_EQ(shop.Sell(invalid_type_id), -1);
+
+    shop.DelProduct(a->GetTypeId());
+    ASSERT_EQ(shop.Sell(a->GetTypeId()), -1);
+    ASSERT_EQ(shop.Sell("A"), -1);
+}
+
+TEST_F(Test, test16) {
+    /** Price changes reach attached shops, updates of a replaced product don't,
+     *  and a shop going away first doesn't bother the products
+     */
+    auto a = std::make_shared<A>(10.0);
+    auto other_a = std::make_shared<A>(30.0);
+    a->StartSales();
+    other_a->StartSales();
+    {
+        IShopImpl shop{ 1 };
+        a->Attach(&shop);
+        a->ChangePrice(12.0);
+        ASSERT_EQ(shop.Sell("A"), 12.0);
+        a->StopSales();
+        ASSERT_EQ(shop.Sell("A"), -1);
+        a->StartSales();
+        ASSERT_EQ(shop.Sell("A"), 12.0);
+
+        other_a->Attach(&shop);
+        a->ChangePrice(13.0);
+        ASSERT_EQ(shop.Sell("A"), 30.0);
+        other_a->ChangePrice(31.0);
+        ASSERT_EQ(shop.Sell("A"), 31.0);
+
+        auto b = std::make_shared<B>(20.0);
+        b->StartSales();
+        b->Attach(&shop);
+        ASSERT_EQ(shop.Sell("B"), 20.0);
+        b.reset();
+        ASSERT_EQ(shop.Sell("B"), -1);
+    }
+    {
+        // an update queued before a detach doesn't outlive the product's next attach
+        IShopImpl shop{ 3 };
+        auto again = std::make_shared<A>(10.0);
+        again->StartSales();
+        again->Attach(&shop);
+        again->ChangePrice(12.0);
+        again->Detach(&shop);
+        again->ChangePrice(13.0);
+        again->Attach(&shop);
+        ASSERT_EQ(shop.Sell("A"), 13.0);
+        ASSERT_EQ(again->GetPrice(), 13.0);
+    }
+    a->ChangePrice(14.0);
+    other_a->ChangePrice(32.0);
+
+    IShopImpl shop{ 2 };
+    a->ChangePrice(100.0);
+    a->Attach(&shop);
+    std::atomic<bool> stop{false};
+    std::atomic<long> bad{0};
+    std::thread seller([&]() {
+        while (!stop.load()) {
+            auto price = shop.Sell("A");
+            bad += price != -1 && (price < 100.0 || price > 200.0);
+        }
+    });
+    for (int i = 0; i < 10000; ++i) {
+        a->ChangePrice(100.0 + i % 100);
+    }
+    a->ChangePrice(200.0);
+    stop = true;
+    seller.join();
+    ASSERT_EQ(bad.load(), 0);
+    ASSERT_EQ(shop.Sell("A"), 200.0);
+}
+
+TEST_F(Test, test17) {
+    /** Sharded engine: shops on different shards see the same price changes,
+     *  each shop counts its own sales and only sells what it lists and what is on sale
+     */
+    auto& registry = TypeRegistry::Instance();
+    const TypeId a = registry.Intern("A");
+    const TypeId b = registry.Intern("B");
+    ShopEngine engine(5, 2, false);
+    ASSERT_EQ(engine.Shards(), 2u);
+    ASSERT_NE(engine.ShardOf(0), engine.ShardOf(1));
+
+    engine.ChangePrice(a, 10.0);
+    engine.StartSales(a);
+    engine.ChangePrice(b, 20.0);
+    engine.Attach(0, a);
+    engine.Attach(1, a);
+    engine.Attach(1, b);
+    engine.Sell(0, a);
+    engine.Sell(1, a);
+    engine.Sell(1, b);
+    engine.Sell(4, a);
+    engine.StartSales(b);
+    engine.ChangePrice(a, 11.0);
+    engine.Sell(1, b);
+    engine.Sell(0, a);
+    engine.Detach(0, a);
+    engine.Sell(0, a);
+
+    auto sales = engine.Sales(0);
+    ASSERT_EQ(sales.m_sold, 2u);
+    ASSERT_EQ(sales.m_failed, 1u);
+    ASSERT_EQ(sales.m_revenue, 21.0);
+    sales = engine.Sales(1);
+    ASSERT_EQ(sales.m_sold, 2u);
+    ASSERT_EQ(sales.m_failed, 1u);
+    ASSERT_EQ(sales.m_revenue, 30.0);
+    ASSERT_EQ(engine.Sales(4).m_failed, 1u);
+    ASSERT_THROW(engine.Sell(5, a), std::out_of_range);
+
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < 3; ++c) {
+        clients.emplace_back([&]() {
+            for (int i = 0; i < 1000; ++i) {
+                engine.Sell(3, a);
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    engine.Attach(3, a);
+    engine.Flush();
+    ASSERT_EQ(engine.Sales(3).m_failed, 3000u);
+}
+
+TEST_F(Test, test18) {
+    /** SellAll appends a record per sale to the log, whose writer puts them into the sink;
+     *  records of threads that already exited are written too
+     */
+    std::ostringstream text;
+    SalesLog log(std::make_unique<TextSalesSink>(text));
+    IShopImpl shop{ 7, &log };
+    auto a = std::make_shared<A>(10.5);
+    auto b = std::make_shared<B>(20.0);
+    a->StartSales();
+    a->Attach(&shop);
+    b->Attach(&shop);
+    shop.SellAll();
+    log.Flush();
+    ASSERT_EQ(text.str(), "7 sell A: 10.5\n");
+
+    std::thread([&]() { shop.SellAll(); }).join();
+    log.Flush();
+    ASSERT_EQ(text.str(), "7 sell A: 10.5\n7 sell A: 10.5\n");
+    ASSERT_EQ(log.Dropped(), 0u);
+
+    char name[] = "/tmp/task_3_test18_XXXXXX";
+    const int fd = mkstemp(name);
+    ASSERT_NE(fd, -1);
+    close(fd);
+    const std::string path = name;
+    {
+        // the writer only drains on Flush or destruction, so the fifth record doesn't fit
+        SalesLog binary(std::make_unique<BinarySalesFile>(path), 4, std::chrono::hours(1));
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(binary.Append({SaleRecord::Now(), i, a->GetTypeId(), 1.0 * i}));
+        }
+        ASSERT_FALSE(binary.Append({SaleRecord::Now(), 4, a->GetTypeId(), 4.0}));
+        ASSERT_EQ(binary.Dropped(), 1u);
+    }
+    auto records = BinarySalesFile::Read(path);
+    std::remove(path.c_str());
+    ASSERT_EQ(records.size(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(records[i].m_shop, i);
+        ASSERT_EQ(records[i].m_type, a->GetTypeId());
+        ASSERT_EQ(records[i].m_price, 1.0 * i);
+    }
+
+    // sales a full log drops are printed instead
+    std::ostringstream small_text;
+    {
+        SalesLog small(std::make_unique<TextSalesSink>(small_text), 2, std::chrono::hours(1));
+        IShopImpl small_shop{ 8, &small };
+        auto c = std::make_shared<C>(30.0);
+        b->StartSales();
+        c->StartSales();
+        a->Attach(&small_shop);
+        b->Attach(&small_shop);
+        c->Attach(&small_shop);
+        testing::internal::CaptureStdout();
+        small_shop.SellAll();
+        ASSERT_EQ(testing::internal::GetCapturedStdout(), "8 sell C: 30\n");
+    }
+    ASSERT_EQ(small_text.str(), "8 sell A: 10.5\n8 sell B: 20\n");
+}
+
+TEST_F(Test, test19) {
+    /** SellBatch resolves a whole basket, reports every item, and keeps the shop's revenue and units sold
+     */
+    IShopImpl shop{ 1 };
+    auto a = std::make_shared<A>(10.0);
+    auto b = std::make_shared<B>(20.0);
+    auto c = std::make_shared<C>(30.0);
+    a->StartSales();
+    b->StartSales();
+    a->Attach(&shop);
+    b->Attach(&shop);
+    c->Attach(&shop);
+
+    const std::vector<TypeId> basket = {a->GetTypeId(), c->GetTypeId(), b->GetTypeId(), a->GetTypeId(), invalid_type_id};
+    std::vector<SaleResult> results(basket.size());
+    auto totals = shop.SellBatch(basket.data(), basket.size(), results.data());
+    ASSERT_EQ(totals.m_sold, 3u);
+    ASSERT_EQ(totals.m_failed, 2u);
+    ASSERT_EQ(totals.m_revenue, 40.0);
+    ASSERT_TRUE(results[0].m_sold);
+    ASSERT_EQ(results[0].m_price, 10.0);
+    ASSERT_FALSE(results[1].m_sold);
+    ASSERT_EQ(results[2].m_price, 20.0);
+    ASSERT_FALSE(results[4].m_sold);
+
+    b->ChangePrice(25.0);
+    const std::string names[] = {"B", "D"};
+    totals = shop.SellBatch(names, 2, results.data());
+    ASSERT_EQ(totals.m_sold, 1u);
+    ASSERT_EQ(results[0].m_price, 25.0);
+    ASSERT_FALSE(results[1].m_sold);
+
+    ASSERT_EQ(shop.Sell("A"), 10.0);
+    ASSERT_EQ(shop.Sell("C"), -1);
+    ASSERT_EQ(shop.UnitsSold(), 5u);
+    ASSERT_EQ(shop.Revenue(), 75.0);
+    ASSERT_EQ(shop.SellBatch(basket.data(), 0, results.data()).m_sold, 0u);
+}
+
+class PooledA : public A {
+public:
+    PooledA(double price) : A(price) {};
+};
+
+TEST_F(Test, test20) {
+    /** Pooled products behave like any other, and their blocks are recycled once
+     *  the last shared_ptr and weak_ptr are gone, on whichever thread that happens
+     */
+    ASSERT_EQ(PooledStats<PooledA>().m_allocated, 0u);
+    IShopImpl shop{ 1 };
+    auto a = MakePooled<PooledA>(10.0);
+    a->StartSales();
+    a->Attach(&shop);
+    ASSERT_EQ(shop.Sell("A"), 10.0);
+    auto stats = PooledStats<PooledA>();
+    ASSERT_EQ(stats.m_live, 1u);
+    ASSERT_EQ(stats.m_recycled, 0u);
+    ASSERT_EQ(stats.m_slabs, 1u);
+
+    a.reset();
+    ASSERT_EQ(shop.Sell("A"), -1);
+    // the shop's weak_ptr still holds the block
+    ASSERT_EQ(PooledStats<PooledA>().m_live, 1u);
+    shop.DelProduct(TypeRegistry::Instance().Intern("A"));
+    ASSERT_EQ(PooledStats<PooledA>().m_live, 0u);
+
+    std::vector<std::shared_ptr<PooledA>> products;
+    for (int i = 0; i < 1000; ++i) {
+        products.push_back(MakePooled<PooledA>(i));
+    }
+    stats = PooledStats<PooledA>();
+    ASSERT_EQ(stats.m_live, 1000u);
+    ASSERT_EQ(stats.m_recycled, 1u);
+    ASSERT_GE(stats.m_peak, 1000u);
+    ASSERT_EQ(products[999]->GetPrice(), 999.0);
+
+    std::thread([&]() {
+        products.clear();
+        for (int i = 0; i < 100; ++i) {
+            MakePooled<PooledA>(i);
+        }
+    }).join();
+    stats = PooledStats<PooledA>();
+    ASSERT_EQ(stats.m_live, 0u);
+    ASSERT_EQ(stats.m_allocated, 1101u);
+    ASSERT_EQ(stats.m_recycled, 101u);
+}
+
+TEST_F(Test, test21) {
+    /** Ordered pipeline stops taking input while a slow item holds up more than its window behind it
+     */
+    std::atomic<bool> release{false};
+    auto pipeline = Pipeline<int>(4, true)
+        .Then("slow first", 4, [&](int x) {
+            while (x == 0 && !release.load()) {
+                std::this_thread::yield();
+            }
+            return x;
+        });
+    std::atomic<int> pushed{0};
+    std::thread producer([&]() {
+        for (int i = 0; i < 1000; ++i) {
+            pipeline.Push(i);
+            ++pushed;
+        }
+        pipeline.Close();
+    });
+    int expected = 0;
+    bool ordered = true;
+    std::thread consumer([&]() {
+        int item = 0;
+        while (pipeline.Pop(item)) {
+            ordered = ordered && item == expected++;
+        }
+    });
+    // the consumer keeps pulling everything behind item 0 into the reorder buffer meanwhile;
+    // wait for the producer to get at least a window in, then for it to stop moving
+    int pushed_while_stuck = pushed.load();
+    for (int stable = 0; pushed_while_stuck < 16 || stable < 20; ) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        const int now = pushed.load();
+        stable = now == pushed_while_stuck ? stable + 1 : 0;
+        pushed_while_stuck = now;
+    }
+    release = true;
+    producer.join();
+    consumer.join();
+    ASSERT_EQ(pushed_while_stuck, 16);
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(expected, 1000);
+}
+
+TEST_F(Test, test22) {
+    /** Sales and SellAll see the price a product published last with nothing left to apply,
+     *  and the counters add up the sales of more selling threads than they have stripes
+     */
+    IShopImpl shop{ 1 };
+    auto a = std::make_shared<A>(10.0);
+    a->StartSales();
+    a->Attach(&shop);
+    for (int i = 0; i < 1000; ++i) {
+        a->ChangePrice(i);
+        ASSERT_EQ(shop.Sell(a->GetTypeId()), double(i));
+    }
+    ASSERT_EQ(shop.UnitsSold(), 1000u);
+    ASSERT_EQ(shop.Revenue(), 499500.0);
+
+    a->ChangePrice(2.0);
+    std::vector<std::thread> sellers;
+    for (int t = 0; t < 20; ++t) {
+        sellers.emplace_back([&]() {
+            for (int i = 0; i < 1000; ++i) {
+                shop.Sell(a->GetTypeId());
+            }
+        });
+    }
+    for (auto& seller : sellers) {
+        seller.join();
+    }
+    ASSERT_EQ(shop.UnitsSold(), 21000u);
+    ASSERT_EQ(shop.Revenue(), 539500.0);
+
+    // SellAll goes by the same prices
+    testing::internal::CaptureStdout();
+    shop.SellAll();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "1 sell A: 2\n");
+    a->StopSales();
+    testing::internal::CaptureStdout();
+    shop.SellAll();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "");
+    a->StartSales();
+    a.reset();
+    testing::internal::CaptureStdout();
+    shop.SellAll();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "");
+}
+
+TEST_F(Test, test23) {
+    /** Products freed by thread_local destructors after the thread's pool cache is gone go back to the pool
+     */
+    struct THolder {
+        std::vector<std::shared_ptr<PooledA>> m_products;
+    };
+    const auto before = PooledStats<PooledA>();
+    std::thread([]() {
+        // constructed before the cache the first MakePooled creates, so destroyed after it
+        thread_local THolder holder;
+        for (int i = 0; i < 300; ++i) {
+            holder.m_products.push_back(MakePooled<PooledA>(i));
+        }
+    }).join();
+    const auto after = PooledStats<PooledA>();
+    ASSERT_EQ(after.m_live, before.m_live);
+    ASSERT_EQ(after.m_allocated, before.m_allocated + 300);
+
+    // and by ones that allocate
+    struct TLate {
+        ~TLate() {
+            MakePooled<PooledA>(2);
+        }
+    };
+    std::thread([]() {
+        thread_local TLate late;
+        (void)late;
+        MakePooled<PooledA>(1);
+    }).join();
+    ASSERT_EQ(PooledStats<PooledA>().m_live, before.m_live);
+    ASSERT_EQ(PooledStats<PooledA>().m_allocated, before.m_allocated + 302);
+}
+
+TEST_F(Test, test24) {
+    /** A push racing Close either fails or its item comes out of Pop
+     */
+    for (int round = 0; round < 200; ++round) {
+        auto pipeline = Pipeline<int>(16).Then("identity", 2, [](int x) { return x; });
+        std::atomic<int> accepted{0};
+        std::vector<std::thread> pushers;
+        for (int t = 0; t < 3; ++t) {
+            pushers.emplace_back([&]() {
+                while (pipeline.Push(1)) {
+                    ++accepted;
+                }
+            });
+        }
+        std::this_thread::yield();
+        pipeline.Close();
+        int popped = 0;
+        int item = 0;
+        while (pipeline.Pop(item)) {
+            ++popped;
+        }
+        for (auto& pusher : pushers) {
+            pusher.join();
+        }
+        ASSERT_EQ(popped, accepted.load());
+    }
+}
 
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
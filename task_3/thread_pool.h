@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ring_buffer.h"
+
+class PoolTask
+{
+public:
+    virtual ~PoolTask() = default;
+
+    virtual void Run() = 0;
+};
+
+template <typename TFunc>
+class FunctionTask : public PoolTask
+{
+public:
+    explicit FunctionTask(TFunc func)
+        : m_func(std::move(func))
+    {}
+
+    void Run() override
+    {
+        m_func();
+    }
+
+private:
+    TFunc m_func;
+};
+
+// Chase-Lev work-stealing deque (in the C11 formulation of Le et al.). The owner pushes and takes
+// at the bottom without contention, thieves take from the top with a CAS that only races the owner
+// for the last item. Outgrown buffers are kept until the deque dies, since a thief may still be reading one.
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(size_t capacity = 256)
+    {
+        m_buffers.push_back(std::make_unique<TBuffer>(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2))));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // owner only
+    void Push(PoolTask* task)
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_top.load(std::memory_order_acquire);
+        TBuffer* buffer = m_buffer.load(std::memory_order_relaxed);
+        if (bottom - top > static_cast<int64_t>(buffer->m_mask))
+        {
+            buffer = Grow(buffer, top, bottom);
+        }
+        buffer->Put(bottom, task);
+        // a release store rather than the paper's release fence, same code on x86 and visible to TSan
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    // owner only, newest first
+    PoolTask* Take()
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        TBuffer* buffer = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        PoolTask* task = buffer->Get(bottom);
+        if (top == bottom)
+        {
+            // the last item, a thief may be after it as well
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                task = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // any thread, oldest first; nullptr when empty or when another thread won the race
+    PoolTask* Steal()
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+        {
+            return nullptr;
+        }
+        PoolTask* task = m_buffer.load(std::memory_order_acquire)->Get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return task;
+    }
+
+    bool Empty() const
+    {
+        return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+    }
+
+private:
+    struct TBuffer
+    {
+        explicit TBuffer(size_t capacity)
+            : m_mask(capacity - 1)
+            , m_items(new std::atomic<PoolTask*>[capacity])
+        {}
+
+        PoolTask* Get(int64_t index) const
+        {
+            return m_items[index & m_mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t index, PoolTask* task)
+        {
+            m_items[index & m_mask].store(task, std::memory_order_relaxed);
+        }
+
+        const size_t m_mask;
+        const std::unique_ptr<std::atomic<PoolTask*>[]> m_items;
+    };
+
+    alignas(cache_line) std::atomic<int64_t> m_top{0};
+    alignas(cache_line) std::atomic<int64_t> m_bottom{0};
+    std::atomic<TBuffer*> m_buffer{nullptr};
+    // owner only
+    std::vector<std::unique_ptr<TBuffer>> m_buffers;
+
+    TBuffer* Grow(TBuffer* buffer, int64_t top, int64_t bottom)
+    {
+        m_buffers.push_back(std::make_unique<TBuffer>(2 * (buffer->m_mask + 1)));
+        TBuffer* grown = m_buffers.back().get();
+        for (int64_t i = top; i < bottom; ++i)
+        {
+            grown->Put(i, buffer->Get(i));
+        }
+        m_buffer.store(grown, std::memory_order_release);
+        return grown;
+    }
+};
+
+// Work-stealing thread pool. Tasks submitted from a worker go to the bottom of its own deque
+// and run newest first, which keeps recursive splits cache-hot; idle workers steal the oldest
+// (usually the largest) tasks from the others. Tasks from outside the pool go through a shared queue.
+// The destructor runs every task submitted before it.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency())
+    {
+        num_threads = std::max<size_t>(1, num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            m_workers.push_back(std::make_unique<TWorker>());
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            m_workers[i]->m_thread = std::thread([this, i]() { Work(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        m_stopping.store(true, std::memory_order_seq_cst);
+        m_work_available.Notify();
+        for (auto& worker : m_workers)
+        {
+            worker->m_thread.join();
+        }
+    }
+
+    size_t Size() const
+    {
+        return m_workers.size();
+    }
+
+    template <typename TFunc>
+    auto Submit(TFunc func) -> std::future<std::invoke_result_t<TFunc&>>
+    {
+        std::packaged_task<std::invoke_result_t<TFunc&>()> task(std::move(func));
+        auto result = task.get_future();
+        Schedule(new FunctionTask<decltype(task)>(std::move(task)));
+        return result;
+    }
+
+    // calls body(i) for i in [begin, end) in chunks of grain indices, 0 picks a grain giving every worker a few chunks.
+    // The calling thread runs pool tasks while it waits, so nested calls from inside tasks don't deadlock.
+    template <typename TBody>
+    void ParallelFor(size_t begin, size_t end, TBody&& body, size_t grain = 0)
+    {
+        ForEachChunk(begin, end, grain, [&](size_t chunk_begin, size_t chunk_end, size_t) {
+            for (size_t i = chunk_begin; i < chunk_end; ++i)
+            {
+                body(i);
+            }
+        });
+    }
+
+    // reduce(init, map(i)...) over [begin, end); reduce must be associative, init its identity
+    template <typename T, typename TMap, typename TReduce>
+    T ParallelReduce(size_t begin, size_t end, T init, TMap&& map, TReduce&& reduce, size_t grain = 0)
+    {
+        std::vector<T> partials;
+        ForEachChunk(begin, end, grain, [&](size_t chunk_begin, size_t chunk_end, size_t chunk) {
+            T partial = init;
+            for (size_t i = chunk_begin; i < chunk_end; ++i)
+            {
+                partial = reduce(std::move(partial), map(i));
+            }
+            partials[chunk] = std::move(partial);
+        }, [&](size_t num_chunks) { partials.assign(num_chunks, init); });
+        for (auto& partial : partials)
+        {
+            init = reduce(std::move(init), std::move(partial));
+        }
+        return init;
+    }
+
+private:
+    struct TWorker
+    {
+        WorkStealingDeque m_deque;
+        std::thread m_thread;
+        uint64_t m_random = 0;
+    };
+
+    struct TCurrent
+    {
+        ThreadPool* m_pool = nullptr;
+        size_t m_index = 0;
+    };
+
+    std::vector<std::unique_ptr<TWorker>> m_workers;
+    std::mutex m_injection_guard;
+    std::deque<PoolTask*> m_injection;
+    std::atomic<size_t> m_injected{0};
+    std::atomic<bool> m_stopping{false};
+    WaitEvent m_work_available;
+
+    static TCurrent& Current()
+    {
+        thread_local TCurrent current;
+        return current;
+    }
+
+    TWorker* CurrentWorker()
+    {
+        auto& current = Current();
+        return current.m_pool == this ? m_workers[current.m_index].get() : nullptr;
+    }
+
+    void Schedule(PoolTask* task)
+    {
+        if (auto worker = CurrentWorker())
+        {
+            worker->m_deque.Push(task);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> l(m_injection_guard);
+            m_injection.push_back(task);
+            m_injected.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_work_available.Notify();
+    }
+
+    PoolTask* FindTask(TWorker* self)
+    {
+        if (self)
+        {
+            if (auto task = self->m_deque.Take())
+            {
+                return task;
+            }
+        }
+        if (m_injected.load(std::memory_order_relaxed) != 0)
+        {
+            std::lock_guard<std::mutex> l(m_injection_guard);
+            if (!m_injection.empty())
+            {
+                auto task = m_injection.front();
+                m_injection.pop_front();
+                m_injected.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        // start stealing at a random victim, so thieves spread out
+        uint64_t random = self ? (self->m_random = self->m_random * 6364136223846793005ULL + 1442695040888963407ULL) >> 33 : 0;
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            auto& victim = m_workers[(random + i) % m_workers.size()];
+            if (victim.get() == self)
+            {
+                continue;
+            }
+            if (auto task = victim->m_deque.Steal())
+            {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    static void Execute(PoolTask* task)
+    {
+        task->Run();
+        delete task;
+    }
+
+    void Work(size_t index)
+    {
+        Current() = {this, index};
+        TWorker* self = m_workers[index].get();
+        self->m_random = index + 1;
+        while (true)
+        {
+            PoolTask* task = FindTask(self);
+            if (!task)
+            {
+                // a steal can fail on a race with work still there, so spin once more before sleeping
+                HybridWait::Wait(m_work_available, [&]() {
+                    task = FindTask(self);
+                    return task || m_stopping.load(std::memory_order_seq_cst);
+                });
+            }
+            if (!task)
+            {
+                return;
+            }
+            Execute(task);
+        }
+    }
+
+    // runs other tasks until done() holds
+    template <typename TDone>
+    void HelpUntil(TDone&& done)
+    {
+        TWorker* self = CurrentWorker();
+        while (!done())
+        {
+            if (auto task = FindTask(self))
+            {
+                Execute(task);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    template <typename TChunk, typename TPrepare = void (*)(size_t)>
+    void ForEachChunk(size_t begin, size_t end, size_t grain, TChunk&& run_chunk, TPrepare&& prepare = [](size_t) {})
+    {
+        if (begin >= end)
+        {
+            prepare(0);
+            return;
+        }
+        const size_t count = end - begin;
+        if (grain == 0)
+        {
+            grain = std::max<size_t>(1, count / (8 * m_workers.size()));
+        }
+        const size_t num_chunks = (count + grain - 1) / grain;
+        prepare(num_chunks);
+
+        std::atomic<size_t> remaining{num_chunks};
+        std::exception_ptr error;
+        std::mutex error_guard;
+        for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+        {
+            Schedule(new FunctionTask([&, chunk]() {
+                const size_t chunk_begin = begin + chunk * grain;
+                try
+                {
+                    run_chunk(chunk_begin, std::min(end, chunk_begin + grain), chunk);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> l(error_guard);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                }
+                remaining.fetch_sub(1, std::memory_order_release);
+            }));
+        }
+        HelpUntil([&]() { return remaining.load(std::memory_order_acquire) == 0; });
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+using TypeId = uint32_t;
+
+constexpr TypeId invalid_type_id = UINT32_MAX;
+
+// Interns product type names into dense ids, starting at 0. Interning and lookup by name
+// take a mutex, which is fine at registration time; Name is lock-free, since names live
+// in fixed chunks that never move once published.
+class TypeRegistry
+{
+public:
+    static TypeRegistry& Instance()
+    {
+        static TypeRegistry registry;
+        return registry;
+    }
+
+    TypeRegistry(const TypeRegistry&) = delete;
+    TypeRegistry& operator=(const TypeRegistry&) = delete;
+
+    ~TypeRegistry()
+    {
+        for (auto& chunk : m_chunks)
+        {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    TypeId Intern(const std::string& name)
+    {
+        std::lock_guard<std::mutex> l(m_guard);
+        auto it = m_ids.find(name);
+        if (it != m_ids.end())
+        {
+            return it->second;
+        }
+        const TypeId id = m_size.load(std::memory_order_relaxed);
+        if (id >= max_types)
+        {
+            throw std::length_error("too many product types");
+        }
+        auto& chunk = m_chunks[id / chunk_size];
+        if (!chunk.load(std::memory_order_relaxed))
+        {
+            chunk.store(new std::string[chunk_size], std::memory_order_release);
+        }
+        chunk.load(std::memory_order_relaxed)[id % chunk_size] = name;
+        m_ids.emplace(name, id);
+        m_size.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // invalid_type_id if the name was never interned
+    TypeId Find(const std::string& name) const
+    {
+        std::lock_guard<std::mutex> l(m_guard);
+        auto it = m_ids.find(name);
+        return it == m_ids.end() ? invalid_type_id : it->second;
+    }
+
+    // empty for ids Intern never handed out, invalid_type_id included
+    const std::string& Name(TypeId id) const
+    {
+        static const std::string unknown;
+        if (id >= m_size.load(std::memory_order_acquire))
+        {
+            return unknown;
+        }
+        return m_chunks[id / chunk_size].load(std::memory_order_acquire)[id % chunk_size];
+    }
+
+    size_t Size() const
+    {
+        return m_size.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t chunk_size = 1024;
+    static constexpr size_t max_types = chunk_size * 1024;
+
+    mutable std::mutex m_guard;
+    std::unordered_map<std::string, TypeId> m_ids;
+    std::atomic<std::string*> m_chunks[max_types / chunk_size] = {};
+    std::atomic<TypeId> m_size{0};
+
+    TypeRegistry() = default;
+};